@@ -0,0 +1,445 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "Patterns.hpp"
+
+namespace patt {
+    namespace __impl {
+        // forwards to another stream, remembering the furthest position looked at
+        class TrackingStream :
+            public io::IStream {
+        public:
+            TrackingStream(io::IStream& source) :
+                source(source) {}
+
+            std::optional<std::byte>
+            Read() override {
+                intptr_t
+                    iCurr   = this->source.GetPosition();
+                // hitting the end of input counts as looking at it, too
+                this->iFurthest =
+                    std::max(this->iFurthest, iCurr + 1);
+                return this->source.Read();
+            }
+
+            intptr_t
+            GetPosition() override {
+                return this->source.GetPosition();
+            }
+
+            void
+            SetPosition(intptr_t iPosition) override {
+                this->source.SetPosition(iPosition);
+            }
+
+            // exclusive end of the examined input
+            intptr_t
+                iFurthest   = 0;
+
+        private:
+            io::IStream&
+                source;
+        };
+    }
+
+    // re-parses a document after small edits, reusing earlier results: every
+    //  grammar rule evaluation and every iteration of a repetition is remembered
+    //  with the input span it examined (including look-ahead and failed
+    //  alternatives). After Edit() the results whose examined span doesn't
+    //  overlap the edit are kept, shifted if they come after it. The next Parse()
+    //  re-evaluates only what overlaps the edit; a run of unchanged iterations
+    //  is taken over in one step, so a long list of statements costs a lookup
+    //  per run rather than per statement.
+    //
+    //  What remains linear in the document: captures of reused results are
+    //  copied into the flat CaptureList, and Edit() shifts every remembered
+    //  result that comes after the edit. Rules that contain repetitions aren't
+    //  remembered themselves (their repetitions are), so a capture is stored
+    //  once per enclosing repetition, not once per enclosing rule.
+    //
+    //  Rules are assumed to depend on the input only: reused results don't run
+    //  handlers again, and usr_val should be the same for every parse.
+    class IncrementalParser :
+        private __impl::RuleMemo {
+    public:
+        explicit IncrementalParser(Pattern pattern) :
+            pattern(std::move(pattern)) {}
+
+        // parse the whole (edited) document
+        [[nodiscard]]
+        OptMatch
+        Parse(io::IStream& is, CaptureList& captures, const std::any& usr_val = {}) {
+            __impl::TrackingStream
+                tracking(is);
+            tracking.iFurthest  = tracking.GetPosition();
+
+            __impl::RuleMemo*
+                lpPrevious  = std::exchange(__impl::CurrentRuleMemo(), static_cast<__impl::RuleMemo*>(this));
+            this->lpTracking    = &tracking;
+            this->uReused       = 0;
+            this->uEvaluated    = 0;
+
+            OptMatch
+                optMatch;
+            try {
+                optMatch    = this->pattern->Eval(tracking, captures, usr_val);
+            }
+            catch (...) {
+                __impl::CurrentRuleMemo() = lpPrevious;
+                this->lpTracking    = nullptr;
+                throw;
+            }
+
+            __impl::CurrentRuleMemo() = lpPrevious;
+            this->lpTracking    = nullptr;
+            return optMatch;
+        }
+
+        // uRemoved bytes at iOffset were replaced with uInserted new bytes
+        void
+        Edit(intptr_t iOffset, size_t uRemoved, size_t uInserted) {
+            intptr_t
+                iEditEnd    = iOffset + (intptr_t)uRemoved,
+                iDelta      = (intptr_t)uInserted - (intptr_t)uRemoved;
+
+            // results that examined the edit are dropped, the ones after it are shifted
+            editMap(this->mapMemo, iDelta, [&](intptr_t iBegin, Entry& entry) {
+                if (entry.iExamined <= iOffset)
+                    return Keep;
+                if (iBegin < iEditEnd)
+                    return Drop;
+                if (entry.optMatch)
+                    entry.optMatch  = shift(*entry.optMatch, iDelta);
+                for (Match& m : entry.captures)
+                    m   = shift(m, iDelta);
+                entry.iEnd      += iDelta;
+                entry.iExamined += iDelta;
+                return Shift;
+            });
+
+            // runs are checked iteration by iteration, a run starting inside the edit is gone
+            editMap(this->mapRuns, iDelta, [&](intptr_t iBegin, Run& run) {
+                if (iBegin >= iOffset && iBegin < iEditEnd)
+                    return Drop;
+                editRun(run, iOffset, iEditEnd, iDelta);
+                if (run.vecIterations.empty())
+                    return Drop;
+                return (iBegin < iOffset) ? Keep : Shift;
+            });
+            this->lpLastRun = nullptr;
+        }
+
+        // forget every remembered result
+        void
+        Reset() noexcept {
+            this->mapMemo.clear();
+            this->mapRuns.clear();
+            this->lpLastRun = nullptr;
+        }
+
+        // rule results and runs of iterations taken from memory during the last parse
+        [[nodiscard]]
+        size_t
+        Reused() const noexcept {
+            return this->uReused;
+        }
+
+        // rules and iterations evaluated during the last parse
+        [[nodiscard]]
+        size_t
+        Evaluated() const noexcept {
+            return this->uEvaluated;
+        }
+
+        // remembered rule results and iterations
+        [[nodiscard]]
+        size_t
+        Size() const noexcept {
+            size_t
+                uSize   = this->mapMemo.size();
+            for (const auto& [key, run] : this->mapRuns)
+                uSize   += run.vecIterations.size();
+            return uSize;
+        }
+
+    private:
+        struct Entry {
+            OptMatch
+                optMatch;
+            CaptureList
+                captures;
+            // stream position after the rule, and end of the input it examined
+            intptr_t
+                iEnd,
+                iExamined;
+        };
+
+        // one evaluation of a repetition's body
+        struct Iteration {
+            intptr_t
+                iBegin,
+                iEnd,
+                iExamined;
+            // its captures are Run::captures[uCaptures .. next iteration's uCaptures)
+            size_t
+                uCaptures;
+            // the body failed here, ending the repetition
+            bool
+                bFailed;
+        };
+
+        // iterations of one repetition, ordered by position, with their captures in the same order
+        struct Run {
+            std::vector<Iteration>
+                vecIterations;
+            CaptureList
+                captures;
+        };
+
+        using Key =
+            std::pair<intptr_t, const void*>;
+        using MapMemo =
+            std::map<Key, Entry>;
+        using MapRuns =
+            std::map<Key, Run>;
+
+        static Match
+        shift(const Match& m, intptr_t iDelta) noexcept {
+            return Match{ m.Begin() + iDelta, m.End() + iDelta };
+        }
+
+        enum Action {
+            Keep,
+            Shift,
+            Drop
+        };
+
+        // fnEdit decides what happens to each result; shifted keys keep their order, so the
+        //  nodes are moved to the end again without reallocating them
+        template<typename Map, typename Fn>
+        static void
+        editMap(Map& map, intptr_t iDelta, Fn&& fnEdit) {
+            std::vector<typename Map::node_type>
+                vecShifted;
+            for (auto it = map.begin(); it != map.end();) {
+                Action
+                    action  = fnEdit(it->first.first, it->second);
+                if (action == Drop) {
+                    it  = map.erase(it);
+                    continue;
+                }
+                if (action == Keep) {
+                    ++it;
+                    continue;
+                }
+
+                auto
+                    itNext  = std::next(it);
+                vecShifted.push_back(map.extract(it));
+                vecShifted.back().key().first   += iDelta;
+                it  = itNext;
+            }
+
+            // shifted results all start after the ones left in place
+            for (auto& node : vecShifted)
+                map.insert(map.end(), std::move(node));
+        }
+
+        // end of the captures of vecIterations[i]
+        static size_t
+        capturesEnd(const Run& run, size_t i) noexcept {
+            return (i + 1 != run.vecIterations.size())
+                ? run.vecIterations[i + 1].uCaptures
+                : run.captures.size();
+        }
+
+        // drop the iterations that examined the edit and shift the ones after it, in place
+        static void
+        editRun(Run& run, intptr_t iOffset, intptr_t iEditEnd, intptr_t iDelta) {
+            size_t
+                uKept       = 0,
+                uCaptures   = 0;
+            for (size_t i = 0; i != run.vecIterations.size(); ++i) {
+                Iteration
+                    iteration   = run.vecIterations[i];
+                intptr_t
+                    iShift      = 0;
+                if (iteration.iBegin >= iEditEnd)
+                    iShift  = iDelta;
+                else if (iteration.iExamined > iOffset)
+                    continue;
+
+                size_t
+                    uFirst  = iteration.uCaptures,
+                    uLast   = capturesEnd(run, i);
+                iteration.iBegin    += iShift;
+                iteration.iEnd      += iShift;
+                iteration.iExamined += iShift;
+                iteration.uCaptures = uCaptures;
+                for (size_t c = uFirst; c != uLast; ++c)
+                    run.captures[uCaptures++]   = shift(run.captures[c], iShift);
+                run.vecIterations[uKept++]  = iteration;
+            }
+            run.vecIterations.resize(uKept);
+            run.captures.resize(uCaptures);
+        }
+
+        OptMatch
+        EvalRule(const void* lpRule, const Pattern& pattern, io::IStream& is, CaptureList& captures, const std::any& usr_val) override {
+            intptr_t
+                iBegin  = is.GetPosition();
+            Key
+                key     = { iBegin, lpRule };
+
+            auto
+                it      = this->mapMemo.find(key);
+            if (it != this->mapMemo.end()) {
+                const Entry&
+                    entry   = it->second;
+                this->lpTracking->iFurthest =
+                    std::max(this->lpTracking->iFurthest, entry.iExamined);
+                captures.insert(captures.end(), entry.captures.begin(), entry.captures.end());
+                is.SetPosition(entry.iEnd);
+
+                this->uReused   += 1;
+                return entry.optMatch;
+            }
+
+            // measure what this rule alone looks at, then merge it into the caller's span
+            intptr_t
+                iOuter  = std::exchange(this->lpTracking->iFurthest, iBegin);
+            size_t
+                uRuns   = this->uRunCalls;
+            CaptureList
+                local_captures;
+            OptMatch
+                optMatch    = pattern->Eval(is, local_captures, usr_val);
+            intptr_t
+                iExamined   = this->lpTracking->iFurthest;
+            this->lpTracking->iFurthest =
+                std::max(iOuter, iExamined);
+
+            captures.insert(captures.end(), local_captures.begin(), local_captures.end());
+            this->uEvaluated    += 1;
+
+            // repetitions inside are remembered already, and re-running the rest is cheap
+            if (this->uRunCalls != uRuns)
+                return optMatch;
+
+            this->mapMemo.insert_or_assign(key, Entry{
+                optMatch,
+                std::move(local_captures),
+                is.GetPosition(),
+                iExamined });
+            return optMatch;
+        }
+
+        size_t
+        EvalIterations(const void* lpRepeat, intptr_t iRepeat, const Pattern& body, io::IStream& is, CaptureList& captures, const std::any& usr_val) override {
+            this->uRunCalls += 1;
+
+            Key
+                key     = { iRepeat, lpRepeat };
+            if (this->lpLastRun == nullptr || this->keyLastRun != key) {
+                this->lpLastRun     = &this->mapRuns[key];
+                this->keyLastRun    = key;
+            }
+            Run&
+                run     = *this->lpLastRun;
+
+            intptr_t
+                iCurr   = is.GetPosition();
+            auto
+                fnBefore    = [](const Iteration& iteration, intptr_t iPosition) {
+                    return iteration.iBegin < iPosition;
+                };
+            auto
+                it      = std::lower_bound(
+                    run.vecIterations.begin(), run.vecIterations.end(), iCurr, fnBefore);
+
+            if (it != run.vecIterations.end() && it->iBegin == iCurr) {
+                // take over the run of iterations that follow each other from here
+                size_t
+                    uFirst      = (size_t)(it - run.vecIterations.begin()),
+                    uLast       = uFirst;
+                intptr_t
+                    iExamined   = it->iExamined;
+                while (!run.vecIterations[uLast].bFailed
+                    && uLast + 1 != run.vecIterations.size()
+                    && run.vecIterations[uLast + 1].iBegin == run.vecIterations[uLast].iEnd
+                    && !run.vecIterations[uLast + 1].bFailed) {
+                    uLast       += 1;
+                    iExamined   = std::max(iExamined, run.vecIterations[uLast].iExamined);
+                }
+
+                const Iteration&
+                    last    = run.vecIterations[uLast];
+                captures.insert(
+                    captures.end(),
+                    run.captures.begin() + (ptrdiff_t)it->uCaptures,
+                    run.captures.begin() + (ptrdiff_t)capturesEnd(run, uLast));
+                this->lpTracking->iFurthest =
+                    std::max(this->lpTracking->iFurthest, iExamined);
+                is.SetPosition(last.iEnd);
+
+                this->uReused   += 1;
+                return (it->bFailed) ? 0 : uLast - uFirst + 1;
+            }
+
+            intptr_t
+                iOuter  = std::exchange(this->lpTracking->iFurthest, iCurr);
+            CaptureList
+                local_captures;
+            bool
+                bMatched    = body->Eval(is, local_captures, usr_val).has_value();
+            intptr_t
+                iExamined   = this->lpTracking->iFurthest;
+            this->lpTracking->iFurthest =
+                std::max(iOuter, iExamined);
+            captures.insert(captures.end(), local_captures.begin(), local_captures.end());
+            this->uEvaluated    += 1;
+
+            // the body may have added iterations of nested repetitions, look up the slot again
+            Run&
+                runNow  = this->mapRuns[key];
+            it          = std::lower_bound(
+                runNow.vecIterations.begin(), runNow.vecIterations.end(), iCurr, fnBefore);
+            size_t
+                uCaptures   = (it != runNow.vecIterations.end()) ? it->uCaptures : runNow.captures.size();
+            for (auto itNext = it; itNext != runNow.vecIterations.end(); ++itNext)
+                itNext->uCaptures   += local_captures.size();
+
+            runNow.captures.insert(
+                runNow.captures.begin() + (ptrdiff_t)uCaptures,
+                local_captures.begin(), local_captures.end());
+            runNow.vecIterations.insert(it, Iteration{
+                iCurr,
+                is.GetPosition(),
+                iExamined,
+                uCaptures,
+                !bMatched });
+            return (bMatched) ? 1 : 0;
+        }
+
+        Pattern
+            pattern;
+        MapMemo
+            mapMemo;
+        MapRuns
+            mapRuns;
+        // run used last, repetitions look theirs up on every iteration
+        Run*
+            lpLastRun   = nullptr;
+        Key
+            keyLastRun;
+        __impl::TrackingStream*
+            lpTracking  = nullptr;
+        size_t
+            uReused     = 0,
+            uEvaluated  = 0,
+            uRunCalls   = 0;
+    };
+}
@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#include "Patterns.hpp"
+
+#if defined(__SSE2__)
+#   include <emmintrin.h>
+#endif
+
+namespace patt {
+    struct TextPosition {
+        // both 1-based, the column counts bytes
+        size_t
+            uLine,
+            uColumn;
+    };
+
+    // maps input offsets to line:column in O(log n). The index either scans an
+    //  in-memory text lazily, as far as the queried offsets need, or is fed the
+    //  input while it's being matched (see IndexingStream), so no second pass
+    //  over the input is ever needed.
+    class LineIndex {
+    public:
+        LineIndex() = default;
+
+        explicit LineIndex(std::string_view strvText) :
+            strvText(strvText) {}
+
+        // index the next chunk of input
+        void
+        Append(std::string_view strv) {
+            intptr_t
+                iBase   = this->iIndexed;
+            const char*
+                lpBegin = strv.data();
+            size_t
+                uSize   = strv.size(),
+                i       = 0;
+
+#if defined(__SSE2__)
+            const __m128i
+                vNewLine    = _mm_set1_epi8('\n');
+            for (; i + 16 <= uSize; i += 16) {
+                __m128i
+                    vChunk  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lpBegin + i));
+                unsigned
+                    uMask   = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(vChunk, vNewLine));
+                while (uMask != 0) {
+                    unsigned
+                        uBit    = (unsigned)__builtin_ctz(uMask);
+                    this->vecLineStarts.push_back(iBase + (intptr_t)(i + uBit) + 1);
+                    uMask   &= uMask - 1;
+                }
+            }
+#endif
+            while (i != uSize) {
+                const void*
+                    lpFound = std::memchr(lpBegin + i, '\n', uSize - i);
+                if (lpFound == nullptr)
+                    break;
+
+                i   = (size_t)(static_cast<const char*>(lpFound) - lpBegin) + 1;
+                this->vecLineStarts.push_back(iBase + (intptr_t)i);
+            }
+
+            this->iIndexed  += (intptr_t)uSize;
+        }
+
+        void
+        Append(std::byte c) {
+            this->iIndexed  += 1;
+            if ((char)c == '\n')
+                this->vecLineStarts.push_back(this->iIndexed);
+        }
+
+        [[nodiscard]]
+        TextPosition
+        Locate(intptr_t iOffset) {
+            if (iOffset < 0)
+                throw std::out_of_range("patt::LineIndex: negative offset");
+            this->extend(iOffset);
+
+            auto
+                it      = std::upper_bound(
+                    this->vecLineStarts.begin(), this->vecLineStarts.end(), iOffset);
+            size_t
+                uLine   = (size_t)(it - this->vecLineStarts.begin());
+            return TextPosition{
+                uLine,
+                (size_t)(iOffset - *std::prev(it)) + 1 };
+        }
+
+        [[nodiscard]]
+        std::pair<TextPosition, TextPosition>
+        Locate(const Match& match) {
+            return { this->Locate(match.Begin()), this->Locate(match.End()) };
+        }
+
+        // where the input stopped matching, if anything failed at all
+        [[nodiscard]]
+        std::optional<TextPosition>
+        Locate(const Failure& failure) {
+            if (!failure.Any())
+                return std::nullopt;
+            return this->Locate(failure.iPosition);
+        }
+
+        // bytes indexed so far
+        [[nodiscard]]
+        intptr_t
+        Indexed() const noexcept {
+            return this->iIndexed;
+        }
+
+    private:
+        // scan the in-memory text up to the offset, in large steps
+        void
+        extend(intptr_t iOffset) {
+            intptr_t
+                iTextEnd    = (intptr_t)this->strvText.size();
+            if (iOffset < this->iIndexed || this->iIndexed >= iTextEnd)
+                return;
+
+            intptr_t
+                iTarget     = std::min(iTextEnd, std::max(iOffset + 1, this->iIndexed * 2));
+            this->Append(this->strvText.substr(
+                (size_t)this->iIndexed, (size_t)(iTarget - this->iIndexed)));
+        }
+
+        std::string_view
+            strvText;
+        std::vector<intptr_t>
+            vecLineStarts   = { 0 };
+        intptr_t
+            iIndexed        = 0;
+    };
+
+    // forwards to another stream, feeding a LineIndex with every byte
+    //  the first time it's read; the source is expected to start at offset 0
+    class IndexingStream :
+        public io::IStream {
+    public:
+        IndexingStream(io::IStream& source, LineIndex& index) :
+            source(source), index(index) {}
+
+        std::optional<std::byte>
+        Read() override {
+            bool
+                bFresh  = this->source.GetPosition() == this->index.Indexed();
+            auto
+                optc    = this->source.Read();
+            if (optc && bFresh)
+                this->index.Append(*optc);
+            return optc;
+        }
+
+        intptr_t
+        GetPosition() override {
+            return this->source.GetPosition();
+        }
+
+        void
+        SetPosition(intptr_t iPosition) override {
+            this->source.SetPosition(iPosition);
+        }
+
+    private:
+        io::IStream&
+            source;
+        LineIndex&
+            index;
+    };
+}
@@ -0,0 +1,640 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <string_view>
+#include <initializer_list>
+
+#include "Patterns.hpp"
+
+#if defined(__linux__) && defined(__x86_64__)
+#   define PATT_JIT_NATIVE 1
+#   include <sys/mman.h>
+#else
+#   define PATT_JIT_NATIVE 0
+#endif
+
+namespace patt {
+    namespace __impl {
+        // translates a pattern tree into x86-64 machine code (System V ABI):
+        //  intptr_t fn(const uint8_t* pBegin, const uint8_t* pEnd, intptr_t* lpCursor, intptr_t bFinal)
+        // returns the match end relative to pBegin, -1 on failure, or -2 if the
+        // input ran out while bFinal is zero and more of it is needed.
+        //
+        // registers: rdi - cursor, rsi - end of input, r8 - begin of input,
+        //  r9 - end of the last match (differs from the cursor after a look-ahead),
+        //  r10 - lpCursor, r11 - bFinal, rdx - stack pointer at entry,
+        //  rax and rcx are scratch. Backtrack points are pushed onto the machine stack;
+        //  every failure label expects the same stack depth as the node it belongs to.
+        class JitCompiler {
+        public:
+            using Label =
+                size_t;
+
+            [[nodiscard]]
+            static std::optional<std::vector<uint8_t>>
+            Compile(const Pattern& pattern) {
+                JitCompiler
+                    compiler;
+                Label
+                    lblFail = compiler.newLabel();
+
+                // mov r8, rdi; mov r10, rdx; mov r11, rcx; mov rdx, rsp; mov r9, rdi
+                compiler.bytes({ 0x49, 0x89, 0xF8, 0x49, 0x89, 0xD2, 0x49, 0x89, 0xCB });
+                compiler.bytes({ 0x48, 0x89, 0xE2, 0x49, 0x89, 0xF9 });
+                if (!compiler.emit(pattern, lblFail))
+                    return std::nullopt;
+
+                // mov rax, rdi; sub rax, r8; mov [r10], rax; mov rax, r9; sub rax, r8; ret
+                compiler.bytes({ 0x48, 0x89, 0xF8, 0x4C, 0x29, 0xC0, 0x49, 0x89, 0x02 });
+                compiler.bytes({ 0x4C, 0x89, 0xC8, 0x4C, 0x29, 0xC0, 0xC3 });
+
+                // mov rax, -1; ret
+                compiler.bind(lblFail);
+                compiler.bytes({ 0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF, 0xC3 });
+
+                // mov rsp, rdx; mov rax, -2; ret
+                compiler.bind(compiler.lblUnderflow);
+                compiler.bytes({ 0x48, 0x89, 0xD4, 0x48, 0xC7, 0xC0, 0xFE, 0xFF, 0xFF, 0xFF, 0xC3 });
+
+                return compiler.link();
+            }
+
+        private:
+            enum Cond : uint8_t {
+                JB  = 0x2,
+                JAE = 0x3,
+                JNE = 0x5,
+            };
+
+            using Bitmap =
+                std::array<uint8_t, 32>;
+
+            JitCompiler() :
+                lblUnderflow(this->newLabel()) {}
+
+            bool
+            emit(const Pattern& node, Label lblFail) {
+                if (!node.bNegated)
+                    return this->emitNorm(node, lblFail);
+
+                if (auto lpRepeat = dynamic_cast<const RepeatPattern*>(&node))
+                    return this->emitUpTo(*lpRepeat->pattern, lpRepeat->uCount);
+
+                // succeed without consuming anything only if the node fails
+                Label
+                    lblOk   = this->newLabel();
+                this->bytes({ 0x57 });                          // push rdi
+                if (!this->emitNorm(node, lblOk))
+                    return false;
+                this->bytes({ 0x48, 0x83, 0xC4, 0x08 });        // add rsp, 8
+                this->jmp(lblFail);
+                this->bind(lblOk);
+                this->bytes({ 0x5F });                          // pop rdi
+                this->markEnd();
+                return true;
+            }
+
+            bool
+            emitNorm(const Pattern& node, Label lblFail) {
+                if (auto lpStr = dynamic_cast<const StringPattern*>(&node))
+                    return this->emitString(lpStr->str, lblFail);
+
+                if (dynamic_cast<const AnyPattern*>(&node)) {
+                    this->bytes({ 0x48, 0x39, 0xF7 });          // cmp rdi, rsi
+                    this->jmpBounds(JAE, lblFail);
+                    this->bytes({ 0x48, 0xFF, 0xC7 });          // inc rdi
+                    this->markEnd();
+                    return true;
+                }
+
+                if (isByteClass(node)) {
+                    this->emitByteClass(node, lblFail);
+                    this->markEnd();
+                    return true;
+                }
+
+                if (auto lpConcat = dynamic_cast<const ConcatPattern*>(&node)) {
+                    return this->emit(*lpConcat->lhs, lblFail)
+                        && this->emit(*lpConcat->rhs, lblFail);
+                }
+
+                if (auto lpChoice = dynamic_cast<const ChoicePattern*>(&node)) {
+                    Label
+                        lblRhs  = this->newLabel(),
+                        lblDone = this->newLabel();
+                    this->bytes({ 0x57 });                      // push rdi
+                    if (!this->emit(*lpChoice->lhs, lblRhs))
+                        return false;
+                    this->bytes({ 0x48, 0x83, 0xC4, 0x08 });    // add rsp, 8
+                    this->jmp(lblDone);
+                    this->bind(lblRhs);
+                    this->bytes({ 0x5F });                      // pop rdi
+                    if (!this->emit(*lpChoice->rhs, lblFail))
+                        return false;
+                    this->bind(lblDone);
+                    this->markEnd();
+                    return true;
+                }
+
+                if (auto lpRepeat = dynamic_cast<const RepeatPattern*>(&node)) {
+                    const Pattern&
+                        inner   = *lpRepeat->pattern;
+                    // an empty match would repeat forever
+                    if (inner.First().bNullable)
+                        return false;
+                    if (!this->emitTimes(inner, lpRepeat->uCount, lblFail))
+                        return false;
+
+                    Label
+                        lblLoop = this->newLabel(),
+                        lblStop = this->newLabel();
+                    this->bind(lblLoop);
+                    if (!inner.bNegated && isByteClass(inner)) {
+                        // span loop over a character class
+                        this->emitByteClass(inner, lblStop);
+                        this->jmp(lblLoop);
+                        this->bind(lblStop);
+                    }
+                    else {
+                        this->bytes({ 0x57 });                  // push rdi
+                        if (!this->emit(inner, lblStop))
+                            return false;
+                        this->bytes({ 0x48, 0x83, 0xC4, 0x08 });// add rsp, 8
+                        this->jmp(lblLoop);
+                        this->bind(lblStop);
+                        this->bytes({ 0x5F });                  // pop rdi
+                    }
+                    this->markEnd();
+                    return true;
+                }
+
+                if (auto lpRepeat = dynamic_cast<const RepeatExactPattern*>(&node)) {
+                    if (!this->emitTimes(*lpRepeat->pattern, lpRepeat->uCount, lblFail))
+                        return false;
+                    this->markEnd();
+                    return true;
+                }
+
+                if (auto lpLookAhead = dynamic_cast<const LookAheadPattern*>(&node)) {
+                    Label
+                        lblInnerFail    = this->newLabel(),
+                        lblDone         = this->newLabel();
+                    this->bytes({ 0x57 });                      // push rdi
+                    if (!this->emit(*lpLookAhead->pattern, lblInnerFail))
+                        return false;
+                    this->bytes({ 0x5F });                      // pop rdi
+                    this->jmp(lblDone);
+                    this->bind(lblInnerFail);
+                    this->bytes({ 0x48, 0x83, 0xC4, 0x08 });    // add rsp, 8
+                    this->jmp(lblFail);
+                    this->bind(lblDone);
+                    return true;
+                }
+
+                // captures, handlers and grammar rules need the interpreter
+                return false;
+            }
+
+            bool
+            emitString(const std::string& str, Label lblFail) {
+                if (str.size() > INT32_MAX)
+                    return false;
+
+                if (!str.empty()) {
+                    // mov rax, rsi; sub rax, rdi; cmp rax, imm32
+                    this->bytes({ 0x48, 0x89, 0xF0, 0x48, 0x29, 0xF8, 0x48, 0x3D });
+                    this->imm32((uint32_t)str.size());
+                    this->jmpBounds(JB, lblFail);
+
+                    size_t
+                        uOffset = 0;
+                    for (; uOffset + 8 <= str.size(); uOffset += 8) {
+                        uint64_t
+                            uChunk;
+                        std::memcpy(&uChunk, str.data() + uOffset, 8);
+                        this->bytes({ 0x48, 0xB8 });            // mov rax, imm64
+                        this->imm64(uChunk);
+                        this->bytes({ 0x48, 0x39, 0x87 });      // cmp [rdi + disp32], rax
+                        this->imm32((uint32_t)uOffset);
+                        this->jcc(JNE, lblFail);
+                    }
+                    for (; uOffset != str.size(); ++uOffset) {
+                        this->bytes({ 0x80, 0xBF });            // cmp byte [rdi + disp32], imm8
+                        this->imm32((uint32_t)uOffset);
+                        this->bytes({ (uint8_t)str[uOffset] });
+                        this->jcc(JNE, lblFail);
+                    }
+
+                    this->bytes({ 0x48, 0x81, 0xC7 });          // add rdi, imm32
+                    this->imm32((uint32_t)str.size());
+                }
+
+                this->markEnd();
+                return true;
+            }
+
+            void
+            emitByteClass(const Pattern& node, Label lblFail) {
+                Bitmap
+                    bitmap  = {};
+                ByteSet
+                    bsBytes = node.normFirst().bsBytes;
+                for (size_t c = 0; c != bsBytes.size(); ++c) {
+                    if (bsBytes.test(c))
+                        bitmap[c >> 3] |= (uint8_t)(1u << (c & 7));
+                }
+
+                this->bytes({ 0x48, 0x39, 0xF7 });              // cmp rdi, rsi
+                this->jmpBounds(JAE, lblFail);
+                this->bytes({ 0x0F, 0xB6, 0x07 });              // movzx eax, byte [rdi]
+                this->bytes({ 0x48, 0x8D, 0x0D });              // lea rcx, [rip + disp32]
+                this->vecBitmapFixups.emplace_back(this->vecCode.size(), this->bitmapIndex(bitmap));
+                this->imm32(0);
+                this->bytes({ 0x48, 0x0F, 0xA3, 0x01 });        // bt [rcx], rax
+                this->jcc(JAE, lblFail);                        // jnc
+                this->bytes({ 0x48, 0xFF, 0xC7 });              // inc rdi
+            }
+
+            // match the node exactly uCount times
+            bool
+            emitTimes(const Pattern& node, size_t uCount, Label lblFail) {
+                if (uCount <= 4) {
+                    for (size_t i = 0; i != uCount; ++i) {
+                        if (!this->emit(node, lblFail))
+                            return false;
+                    }
+                    return true;
+                }
+                if (uCount > INT32_MAX)
+                    return false;
+
+                Label
+                    lblLoop     = this->newLabel(),
+                    lblInnerFail= this->newLabel(),
+                    lblDone     = this->newLabel();
+                this->bytes({ 0x68 });                          // push imm32
+                this->imm32((uint32_t)uCount);
+                this->bind(lblLoop);
+                if (!this->emit(node, lblInnerFail))
+                    return false;
+                this->bytes({ 0x48, 0xFF, 0x0C, 0x24 });        // dec qword [rsp]
+                this->jcc(JNE, lblLoop);
+                this->bytes({ 0x48, 0x83, 0xC4, 0x08 });        // add rsp, 8
+                this->jmp(lblDone);
+                this->bind(lblInnerFail);
+                this->bytes({ 0x48, 0x83, 0xC4, 0x08 });        // add rsp, 8
+                this->jmp(lblFail);
+                this->bind(lblDone);
+                return true;
+            }
+
+            // match the node 0..uCount times, as an inverted RepeatPattern does
+            bool
+            emitUpTo(const Pattern& node, size_t uCount) {
+                if (uCount > INT32_MAX)
+                    return false;
+
+                if (uCount != 0) {
+                    Label
+                        lblLoop = this->newLabel(),
+                        lblStop = this->newLabel(),
+                        lblDone = this->newLabel();
+                    this->bytes({ 0x68 });                      // push imm32
+                    this->imm32((uint32_t)uCount);
+                    this->bind(lblLoop);
+                    this->bytes({ 0x57 });                      // push rdi
+                    if (!this->emit(node, lblStop))
+                        return false;
+                    this->bytes({ 0x48, 0x83, 0xC4, 0x08 });    // add rsp, 8
+                    this->bytes({ 0x48, 0xFF, 0x0C, 0x24 });    // dec qword [rsp]
+                    this->jcc(JNE, lblLoop);
+                    this->jmp(lblDone);
+                    this->bind(lblStop);
+                    this->bytes({ 0x5F });                      // pop rdi
+                    this->bind(lblDone);
+                    this->bytes({ 0x48, 0x83, 0xC4, 0x08 });    // add rsp, 8
+                }
+
+                this->markEnd();
+                return true;
+            }
+
+            static bool
+            isByteClass(const Pattern& node) {
+                return dynamic_cast<const SetPattern*>(&node)
+                    || dynamic_cast<const LocalePattern*>(&node);
+            }
+
+            // mov r9, rdi
+            void
+            markEnd() {
+                this->bytes({ 0x49, 0x89, 0xF9 });
+            }
+
+            // running out of input is a failure only if the input is final
+            void
+            jmpBounds(Cond cond, Label lblFail) {
+                Label
+                    lblOk   = this->newLabel();
+                this->jcc((Cond)(cond ^ 1), lblOk);
+                this->bytes({ 0x4D, 0x85, 0xDB });              // test r11, r11
+                this->bytes({ 0x0F, 0x84 });                    // jz underflow
+                this->rel32(this->lblUnderflow);
+                this->jmp(lblFail);
+                this->bind(lblOk);
+            }
+
+            void
+            jcc(Cond cond, Label lbl) {
+                this->bytes({ 0x0F, (uint8_t)(0x80 | cond) });
+                this->rel32(lbl);
+            }
+
+            void
+            jmp(Label lbl) {
+                this->bytes({ 0xE9 });
+                this->rel32(lbl);
+            }
+
+            void
+            rel32(Label lbl) {
+                this->vecLabelFixups.emplace_back(this->vecCode.size(), lbl);
+                this->imm32(0);
+            }
+
+            Label
+            newLabel() {
+                this->vecLabels.push_back(SIZE_MAX);
+                return this->vecLabels.size() - 1;
+            }
+
+            void
+            bind(Label lbl) {
+                this->vecLabels[lbl] = this->vecCode.size();
+            }
+
+            size_t
+            bitmapIndex(const Bitmap& bitmap) {
+                auto
+                    it  = std::find(this->vecBitmaps.begin(), this->vecBitmaps.end(), bitmap);
+                if (it != this->vecBitmaps.end())
+                    return (size_t)(it - this->vecBitmaps.begin());
+
+                this->vecBitmaps.push_back(bitmap);
+                return this->vecBitmaps.size() - 1;
+            }
+
+            void
+            bytes(std::initializer_list<uint8_t> lst) {
+                this->vecCode.insert(this->vecCode.end(), lst);
+            }
+
+            void
+            imm32(uint32_t u) {
+                for (size_t i = 0; i != 4; ++i)
+                    this->vecCode.push_back((uint8_t)(u >> (8 * i)));
+            }
+
+            void
+            imm64(uint64_t u) {
+                for (size_t i = 0; i != 8; ++i)
+                    this->vecCode.push_back((uint8_t)(u >> (8 * i)));
+            }
+
+            void
+            patch32(size_t uAt, size_t uTarget) {
+                uint32_t
+                    uRel    = (uint32_t)(int32_t)((intptr_t)uTarget - (intptr_t)(uAt + 4));
+                for (size_t i = 0; i != 4; ++i)
+                    this->vecCode[uAt + i] = (uint8_t)(uRel >> (8 * i));
+            }
+
+            std::vector<uint8_t>
+            link() {
+                for (auto [uAt, lbl] : this->vecLabelFixups)
+                    this->patch32(uAt, this->vecLabels[lbl]);
+
+                size_t
+                    uData   = (this->vecCode.size() + 31) & ~(size_t)31;
+                this->vecCode.resize(uData + 32 * this->vecBitmaps.size(), 0xCC);
+                for (size_t i = 0; i != this->vecBitmaps.size(); ++i) {
+                    std::copy(
+                        this->vecBitmaps[i].begin(), this->vecBitmaps[i].end(),
+                        this->vecCode.begin() + (intptr_t)(uData + 32 * i));
+                }
+                for (auto [uAt, uIndex] : this->vecBitmapFixups)
+                    this->patch32(uAt, uData + 32 * uIndex);
+
+                return std::move(this->vecCode);
+            }
+
+            std::vector<uint8_t>
+                vecCode;
+            std::vector<size_t>
+                vecLabels;
+            std::vector<std::pair<size_t, Label>>
+                vecLabelFixups;
+            std::vector<Bitmap>
+                vecBitmaps;
+            std::vector<std::pair<size_t, size_t>>
+                vecBitmapFixups;
+            Label
+                lblUnderflow;
+        };
+    }
+
+    namespace __impl {
+        // read-only stream over in-memory input
+        class ViewStream :
+            public io::IStream {
+        public:
+            ViewStream(std::string_view strv) :
+                strv(strv) {}
+
+            std::optional<std::byte>
+            Read() override {
+                if (this->uPos >= this->strv.size())
+                    return std::nullopt;
+                return (std::byte)this->strv[this->uPos++];
+            }
+
+            intptr_t
+            GetPosition() override {
+                return (intptr_t)this->uPos;
+            }
+
+            void
+            SetPosition(intptr_t iPosition) override {
+                this->uPos  = (size_t)iPosition;
+            }
+
+        private:
+            std::string_view
+                strv;
+            size_t
+                uPos    = 0;
+        };
+    }
+
+    // a pattern with an optional native matcher: on Linux/x86-64 patterns made of
+    // literals, character classes, sequences, choices, repetitions, inversions and
+    // look-aheads run as machine code; captures, handlers and grammar rules (or any
+    // other platform) fall back to the interpreter.
+    class JitPattern {
+    public:
+        explicit JitPattern(Pattern pattern) :
+            pattern(std::move(pattern)) {
+#if PATT_JIT_NATIVE
+            auto
+                optCode = __impl::JitCompiler::Compile(*this->pattern);
+            if (!optCode)
+                return;
+
+            void*
+                lpMemory    = mmap(
+                    nullptr, optCode->size(),
+                    PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (lpMemory == MAP_FAILED)
+                return;
+
+            std::memcpy(lpMemory, optCode->data(), optCode->size());
+            if (mprotect(lpMemory, optCode->size(), PROT_READ | PROT_EXEC) != 0) {
+                munmap(lpMemory, optCode->size());
+                return;
+            }
+
+            this->lpCode    = lpMemory;
+            this->uCodeSize = optCode->size();
+#endif
+        }
+
+        JitPattern(const JitPattern&) = delete;
+        JitPattern& operator=(const JitPattern&) = delete;
+
+        JitPattern(JitPattern&& obj) noexcept :
+            pattern     (std::move(obj.pattern)),
+            lpCode      (std::exchange(obj.lpCode, nullptr)),
+            uCodeSize   (std::exchange(obj.uCodeSize, 0)) {}
+
+        JitPattern&
+        operator=(JitPattern&& obj) noexcept {
+            JitPattern
+                temp    = std::move(obj);
+            std::swap(this->pattern, temp.pattern);
+            std::swap(this->lpCode, temp.lpCode);
+            std::swap(this->uCodeSize, temp.uCodeSize);
+            return *this;
+        }
+
+        ~JitPattern() {
+#if PATT_JIT_NATIVE
+            if (this->lpCode != nullptr)
+                munmap(this->lpCode, this->uCodeSize);
+#endif
+        }
+
+        [[nodiscard]]
+        bool
+        IsNative() const noexcept {
+            return this->lpCode != nullptr;
+        }
+
+        [[nodiscard]]
+        const Pattern&
+        GetPattern() const noexcept {
+            return this->pattern;
+        }
+
+        // same result as patt::Eval; on failure the stream is rewound if running natively.
+        //  Input is buffered starting with a single byte and doubled whenever the
+        //  native code runs out of it, so it never reads more than twice as far
+        //  as the interpreter would.
+        [[nodiscard]]
+        OptMatch
+        Eval(io::IStream& is, CaptureList& captures, const std::any& usr_val = {}) const {
+            if (!this->IsNative())
+                return this->pattern->Eval(is, captures, usr_val);
+
+            intptr_t
+                iBegin  = is.GetPosition();
+            __impl::BacktrackPoint
+                backtrack(is, iBegin);
+            std::string
+                strBuffer;
+            size_t
+                uWanted = 1;
+            bool
+                bFinal  = false;
+            while (true) {
+                while (!bFinal && strBuffer.size() < uWanted) {
+                    auto
+                        optc    = is.Read();
+                    if (!optc)
+                        bFinal  = true;
+                    else
+                        strBuffer.push_back((char)*optc);
+                }
+
+                intptr_t
+                    iCursor = 0,
+                    iEnd    = this->run(strBuffer, iCursor, bFinal);
+                if (iEnd == -2) {
+                    uWanted *= 2;
+                    continue;
+                }
+
+                if (iEnd < 0) {
+                    is.SetPosition(iBegin);
+                    return std::nullopt;
+                }
+
+                is.SetPosition(iBegin + iCursor);
+                return Match{ iBegin, iBegin + iEnd };
+            }
+        }
+
+        // match in-memory input, offsets are relative to its start;
+        //  captures of an interpreted pattern are discarded
+        [[nodiscard]]
+        OptMatch
+        Eval(std::string_view strv) const {
+            if (!this->IsNative()) {
+                __impl::ViewStream
+                    is(strv);
+                CaptureList
+                    captures;
+                return this->pattern->Eval(is, captures);
+            }
+
+            intptr_t
+                iCursor = 0,
+                iEnd    = this->run(strv, iCursor, true);
+            if (iEnd < 0)
+                return std::nullopt;
+            return Match{ 0, iEnd };
+        }
+
+    private:
+        using NativeProc =
+            intptr_t (*)(const uint8_t*, const uint8_t*, intptr_t*, intptr_t);
+
+        intptr_t
+        run(std::string_view strv, intptr_t& iCursor, bool bFinal) const {
+            auto
+                lpfn    = reinterpret_cast<NativeProc>(this->lpCode);
+            auto
+                lpBegin = reinterpret_cast<const uint8_t*>(strv.data());
+            return lpfn(lpBegin, lpBegin + strv.size(), &iCursor, (intptr_t)bFinal);
+        }
+
+        Pattern
+            pattern;
+        void*
+            lpCode      = nullptr;
+        size_t
+            uCodeSize   = 0;
+    };
+}
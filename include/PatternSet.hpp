@@ -0,0 +1,202 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "Patterns.hpp"
+
+namespace patt {
+    struct SetMatch {
+        size_t
+            uIndex;
+        Match
+            match;
+        CaptureList
+            captures;
+    };
+
+    using SetMatchList =
+        std::vector<SetMatch>;
+
+    // evaluates many independent patterns at the same input position:
+    //  the input is read once, literal prefixes are matched together through
+    //  a shared trie and the rest is dispatched by the first input byte, so
+    //  only the patterns that can still match get evaluated. The tables are
+    //  built on first use and again once a grammar rule they looked through
+    //  is redefined.
+    class PatternSet {
+    public:
+        // returns the index the pattern is reported with
+        size_t
+        Add(Pattern pattern) {
+            __impl::LiteralPrefix
+                prefix  = pattern->Prefix();
+            this->vecPatterns.push_back(Entry{
+                std::move(pattern),
+                prefix.bExact ? prefix.str.size() : SIZE_MAX });
+            this->lazyTables.Reset();
+            return this->vecPatterns.size() - 1;
+        }
+
+        [[nodiscard]]
+        size_t
+        Size() const noexcept {
+            return this->vecPatterns.size();
+        }
+
+        // matches of every pattern at the current position, in the order the
+        // patterns were added; the stream position is left unchanged.
+        [[nodiscard]]
+        SetMatchList
+        Eval(io::IStream& is, const std::any& usr_val = {}) const {
+            std::shared_ptr<const Tables>
+                lpTables    = this->lazyTables.Get([this]() {
+                    return this->buildTables();
+                });
+            const Tables&
+                tables      = *lpTables;
+
+            intptr_t
+                iBegin  = is.GetPosition();
+            __impl::BacktrackPoint
+                backtrack(is, iBegin);
+
+            std::string
+                strWindow;
+            size_t
+                uWindow = std::max<size_t>(tables.uMaxPrefix, 1);
+            strWindow.reserve(uWindow);
+            while (strWindow.size() != uWindow) {
+                auto
+                    optc    = is.Read();
+                if (!optc)
+                    break;
+                strWindow.push_back((char)*optc);
+            }
+
+            std::vector<uint32_t>
+                vecCandidates   = (strWindow.empty())
+                    ? tables.vecAtEnd
+                    : tables.arrDispatch[(unsigned char)strWindow.front()];
+
+            uint32_t
+                uNode   = 0;
+            for (char c : strWindow) {
+                const auto&
+                    mapNext = tables.vecTrie[uNode].mapNext;
+                auto
+                    it      = mapNext.find(c);
+                if (it == mapNext.end())
+                    break;
+
+                uNode   = it->second;
+                vecCandidates.insert(
+                    vecCandidates.end(),
+                    tables.vecTrie[uNode].vecPatterns.begin(),
+                    tables.vecTrie[uNode].vecPatterns.end());
+            }
+            std::sort(vecCandidates.begin(), vecCandidates.end());
+
+            SetMatchList
+                matches;
+            for (uint32_t uIndex : vecCandidates) {
+                const Entry&
+                    entry   = this->vecPatterns[uIndex];
+                if (entry.uExactLen != SIZE_MAX) {
+                    matches.push_back(SetMatch{
+                        uIndex,
+                        Match{ iBegin, iBegin + (intptr_t)entry.uExactLen },
+                        {} });
+                    continue;
+                }
+
+                is.SetPosition(iBegin);
+                CaptureList
+                    captures;
+                OptMatch
+                    optm    = entry.pattern->Eval(is, captures, usr_val);
+                if (optm)
+                    matches.push_back(SetMatch{ uIndex, *optm, std::move(captures) });
+            }
+
+            is.SetPosition(iBegin);
+            return matches;
+        }
+
+    private:
+        struct Entry {
+            Pattern
+                pattern;
+            // length of the literal the pattern is equivalent to, if any
+            size_t
+                uExactLen;
+        };
+
+        struct TrieNode {
+            std::map<char, uint32_t>
+                mapNext;
+            std::vector<uint32_t>
+                vecPatterns;
+        };
+
+        struct Tables {
+            std::vector<TrieNode>
+                vecTrie     = { TrieNode{} };
+            std::array<std::vector<uint32_t>, 256>
+                arrDispatch;
+            std::vector<uint32_t>
+                vecAtEnd;
+            size_t
+                uMaxPrefix  = 0;
+        };
+
+        std::shared_ptr<const Tables>
+        buildTables() const {
+            auto
+                lpTables    = std::make_shared<Tables>();
+            for (uint32_t uIndex = 0; uIndex != this->vecPatterns.size(); ++uIndex) {
+                const Pattern&
+                    pattern = this->vecPatterns[uIndex].pattern;
+                __impl::LiteralPrefix
+                    prefix  = pattern->Prefix();
+
+                if (!prefix.str.empty()) {
+                    uint32_t
+                        uNode   = 0;
+                    for (char c : prefix.str) {
+                        auto
+                            it  = lpTables->vecTrie[uNode].mapNext.find(c);
+                        if (it == lpTables->vecTrie[uNode].mapNext.end()) {
+                            it  = lpTables->vecTrie[uNode].mapNext.emplace(
+                                c, (uint32_t)lpTables->vecTrie.size()).first;
+                            lpTables->vecTrie.emplace_back();
+                        }
+                        uNode   = it->second;
+                    }
+
+                    lpTables->vecTrie[uNode].vecPatterns.push_back(uIndex);
+                    lpTables->uMaxPrefix    = std::max(lpTables->uMaxPrefix, prefix.str.size());
+                    continue;
+                }
+
+                __impl::FirstSet
+                    first   = pattern->First();
+                // skipping would skip the handlers run before the first byte is read
+                if (first.bHandlers)
+                    first.bNullable = true;
+                for (size_t c = 0; c != lpTables->arrDispatch.size(); ++c) {
+                    if (first.Accepts((std::byte)c))
+                        lpTables->arrDispatch[c].push_back(uIndex);
+                }
+                if (first.Accepts(std::nullopt))
+                    lpTables->vecAtEnd.push_back(uIndex);
+            }
+            return lpTables;
+        }
+
+        std::vector<Entry>
+            vecPatterns;
+        __impl::LazyAnalysis<Tables>
+            lazyTables;
+    };
+}
\ No newline at end of file
@@ -1,12 +1,24 @@
 #pragma once
 #include <any>
 #include <map>
+#include <span>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <bitset>
 #include <memory>
 #include <string>
+#include <vector>
 #include <cassert>
+#include <typeinfo>
 #include <flat_set>
+#include <utility>
 #include <optional>
+#include <algorithm>
 #include <functional>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <classy-streams/IOStreams.hpp>
 #include <string_view>
@@ -15,6 +27,7 @@ namespace patt {
     namespace __impl {
         class Pattern;
         class Grammar;
+        class JitCompiler;
     }
 
     using Grammar   =
@@ -111,8 +124,273 @@ namespace patt {
         std::vector<Match>;
 
     namespace __impl {
+        // memory resource the pattern nodes are currently allocated from
+        inline std::shared_ptr<std::pmr::memory_resource>&
+        CurrentResource() noexcept {
+            static thread_local std::shared_ptr<std::pmr::memory_resource>
+                lpResource  = nullptr;
+            return lpResource;
+        }
+
+        // allocates from a shared resource and keeps it alive, so a node (and its
+        //  control block) can be released after whoever made the resource is gone
+        template<typename T>
+        class SharedResourceAllocator {
+        public:
+            using value_type =
+                T;
+
+            SharedResourceAllocator(std::shared_ptr<std::pmr::memory_resource> lpResource) noexcept :
+                lpResource(std::move(lpResource)) {}
+
+            template<typename U>
+            SharedResourceAllocator(const SharedResourceAllocator<U>& other) noexcept :
+                lpResource(other.lpResource) {}
+
+            [[nodiscard]]
+            T*
+            allocate(size_t uCount) {
+                return static_cast<T*>(this->lpResource->allocate(uCount * sizeof(T), alignof(T)));
+            }
+
+            void
+            deallocate(T* lpBlock, size_t uCount) noexcept {
+                this->lpResource->deallocate(lpBlock, uCount * sizeof(T), alignof(T));
+            }
+
+            template<typename U>
+            bool
+            operator==(const SharedResourceAllocator<U>& other) const noexcept {
+                return this->lpResource == other.lpResource;
+            }
+
+        private:
+            template<typename U>
+            friend class SharedResourceAllocator;
+
+            std::shared_ptr<std::pmr::memory_resource>
+                lpResource;
+        };
+
+        template<typename T, typename... Args>
+        [[nodiscard]]
+        inline std::shared_ptr<T>
+        MakePattern(Args&&... args) {
+            const auto&
+                lpResource  = CurrentResource();
+            if (lpResource == nullptr)
+                return std::make_shared<T>(std::forward<Args>(args)...);
+            return std::allocate_shared<T>(
+                SharedResourceAllocator<T>(lpResource),
+                std::forward<Args>(args)...);
+        }
+
+        // a stream that discards its input (see WindowStream) and so needs to know
+        //  the positions evaluation may still rewind to
+        class TrackedStream {
+        public:
+            TrackedStream() {
+                Alive().fetch_add(1, std::memory_order_relaxed);
+            }
+
+            TrackedStream(const TrackedStream&) = delete;
+            TrackedStream& operator=(const TrackedStream&) = delete;
+
+            virtual ~TrackedStream() {
+                Alive().fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            // tracked streams in the process, so evaluation only looks for them if there are any
+            static std::atomic<size_t>&
+            Alive() noexcept {
+                static std::atomic<size_t>
+                    uAlive  = 0;
+                return uAlive;
+            }
+
+            // positions still needed by evaluations running on this stream, oldest first
+            std::vector<intptr_t>
+                vecBacktrack;
+        };
+
+        // a position evaluation may rewind the stream to while the point is alive
+        class BacktrackPoint {
+        public:
+            BacktrackPoint(io::IStream& is, intptr_t iPosition) {
+                if (TrackedStream::Alive().load(std::memory_order_relaxed) == 0)
+                    return;
+                if (auto lpTracked = dynamic_cast<TrackedStream*>(&is)) {
+                    this->lpPoints  = &lpTracked->vecBacktrack;
+                    this->lpPoints->push_back(iPosition);
+                }
+            }
+
+            BacktrackPoint(const BacktrackPoint&) = delete;
+            BacktrackPoint& operator=(const BacktrackPoint&) = delete;
+
+            ~BacktrackPoint() {
+                if (this->lpPoints != nullptr)
+                    this->lpPoints->pop_back();
+            }
+
+            void
+            Move(intptr_t iPosition) noexcept {
+                if (this->lpPoints != nullptr)
+                    this->lpPoints->back() = iPosition;
+            }
+
+        private:
+            std::vector<intptr_t>*
+                lpPoints    = nullptr;
+        };
+
+        // farthest input position a terminal failed at, tracked only while
+        //  evaluating through the patt::Eval overload that reports it
+        inline intptr_t*&
+        CurrentFailure() noexcept {
+            static thread_local intptr_t*
+                lpFarthest  = nullptr;
+            return lpFarthest;
+        }
+
+        inline void
+        RecordFailure(intptr_t iPosition) noexcept {
+            if (intptr_t* lpFarthest = CurrentFailure())
+                *lpFarthest = std::max(*lpFarthest, iPosition);
+        }
+
+        inline size_t
+        HashCombine(size_t uSeed, size_t uValue) noexcept {
+            return uSeed ^ (uValue + 0x9e3779b97f4a7c15 + (uSeed << 6) + (uSeed >> 2));
+        }
+
+        using ByteSet =
+            std::bitset<256>;
+
+        // bytes a pattern may succeed on, conservative (a superset)
+        struct FirstSet {
+            // a match may start with one of these bytes; on any other byte the
+            //  pattern fails right there, without reading further
+            ByteSet
+                bsBytes     = {};
+            // a match may consume nothing, so any byte (or end of input) will do
+            bool
+                bNullable   = false;
+            // a handler may be called with a match before the first byte is consumed
+            bool
+                bHandlers   = false;
+
+            [[nodiscard]]
+            bool
+            Accepts(std::optional<std::byte> optc) const noexcept {
+                return this->bNullable
+                    || (optc && this->bsBytes.test((size_t)*optc));
+            }
+
+            auto&
+            operator|=(const FirstSet& other) noexcept {
+                this->bsBytes   |= other.bsBytes;
+                this->bNullable = this->bNullable || other.bNullable;
+                this->bHandlers = this->bHandlers || other.bHandlers;
+                return *this;
+            }
+        };
+
+        // bumped whenever a grammar rule is (re)defined
+        inline std::atomic<uint64_t>&
+        RuleGeneration() noexcept {
+            static std::atomic<uint64_t>
+                uGeneration = 0;
+            return uGeneration;
+        }
+
+        // a grammar rule, stamped with the generation it was last defined at
+        struct Rule {
+            patt::Pattern
+                pattern     = nullptr;
+            uint64_t
+                uStamp      = 0;
+
+            void
+            Restamp() noexcept {
+                this->uStamp    = RuleGeneration().fetch_add(1, std::memory_order_acq_rel) + 1;
+            }
+        };
+
+        // rules an analysis looked through, with the stamps they had then
+        struct RuleStamps {
+            std::vector<std::pair<const Rule*, uint64_t>>
+                vecRules;
+
+            [[nodiscard]]
+            bool
+            Current() const noexcept {
+                return std::all_of(this->vecRules.begin(), this->vecRules.end(), [](const auto& stamp) {
+                    return stamp.first->uStamp == stamp.second;
+                });
+            }
+        };
+
+        // state of one FIRST-set analysis: rules already done, rules being expanded
+        //  and every rule looked at
+        struct FirstContext {
+            std::unordered_set<const void*>
+                setActive;
+            std::unordered_map<const void*, FirstSet>
+                mapRules;
+            std::unordered_map<const Rule*, uint64_t>
+                mapStamps;
+
+            void
+            Record(const Rule& rule) {
+                this->mapStamps.emplace(&rule, rule.uStamp);
+            }
+
+            [[nodiscard]]
+            RuleStamps
+            Stamps() const {
+                return RuleStamps{ { this->mapStamps.begin(), this->mapStamps.end() } };
+            }
+        };
+
+        inline FirstContext*&
+        CurrentFirstContext() noexcept {
+            static thread_local FirstContext*
+                lpContext   = nullptr;
+            return lpContext;
+        }
+
+        // analyses made while the scope lives share the context
+        class FirstScope {
+        public:
+            FirstScope(FirstContext& context) :
+                lpPrevious(std::exchange(CurrentFirstContext(), &context)) {}
+
+            FirstScope(const FirstScope&) = delete;
+            FirstScope& operator=(const FirstScope&) = delete;
+
+            ~FirstScope() {
+                CurrentFirstContext()   = this->lpPrevious;
+            }
+
+        private:
+            FirstContext*
+                lpPrevious;
+        };
+
+        // literal every match of a pattern starts with
+        struct LiteralPrefix {
+            std::string
+                str         = {};
+            // the pattern matches exactly this literal and has no side effects
+            bool
+                bExact      = false;
+        };
+
         class Pattern {
         public:
+            friend class JitCompiler;
+
             Pattern(const Pattern&) = default;
             Pattern()               = default;
             virtual ~Pattern()      = default;
@@ -128,16 +406,95 @@ namespace patt {
             virtual patt::Pattern
             Clone() const = 0;
 
+            // structural hash, child nodes are hashed by address
+            [[nodiscard]]
+            size_t
+            Hash() const {
+                size_t
+                    uHash   = HashCombine(typeid(*this).hash_code(), (size_t)this->bNegated);
+                return HashCombine(uHash, this->hashNode());
+            }
+
+            // structural equality, child nodes are compared by address
+            [[nodiscard]]
+            bool
+            Equals(const Pattern& other) const {
+                return typeid(*this) == typeid(other)
+                    && this->bNegated == other.bNegated
+                    && this->equalNode(other);
+            }
+
+            // approximate memory taken by the node itself, children excluded
+            [[nodiscard]]
+            virtual size_t
+            Footprint() const = 0;
+
+            // visit (and possibly replace) direct child nodes
+            virtual void
+            VisitChildren(const std::function<void(patt::Pattern&)>&) {}
+
+            [[nodiscard]]
+            FirstSet
+            First() const {
+                if (CurrentFirstContext() != nullptr) {
+                    return (this->bNegated)
+                        ? this->negFirst()
+                        : this->normFirst();
+                }
+
+                // outermost call, grammar rules share one context
+                FirstContext
+                    context;
+                FirstScope
+                    scope(context);
+                return this->First();
+            }
+
+            [[nodiscard]]
+            LiteralPrefix
+            Prefix() const {
+                return (this->bNegated)
+                    ? LiteralPrefix{}
+                    : this->normPrefix();
+            }
+
             // pattern inversion
             [[nodiscard]]
             friend patt::Pattern
             operator-(patt::Pattern&& pattern) {
+                // shared nodes must stay immutable, invert a private copy instead
+                if (pattern.use_count() > 1)
+                    pattern = pattern->Clone();
                 pattern->bNegated =
                     !pattern->bNegated;
                 return pattern;
             }
         
         protected:
+            virtual size_t
+            hashNode() const = 0;
+
+            virtual bool
+            equalNode(const Pattern& other) const = 0;
+
+            virtual FirstSet
+            normFirst() const = 0;
+
+            // an inverted pattern only matches where the original fails, consuming nothing;
+            //  the original still reads ahead (and may call handlers) on the bytes it starts with
+            virtual FirstSet
+            negFirst() const {
+                FirstSet
+                    first   = this->normFirst();
+                first.bNullable = true;
+                return first;
+            }
+
+            virtual LiteralPrefix
+            normPrefix() const {
+                return {};
+            }
+
             virtual OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const = 0;
 
@@ -145,14 +502,17 @@ namespace patt {
             negEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const {
                 intptr_t
                     iCurr   = is.GetPosition();
+                BacktrackPoint
+                    backtrack(is, iCurr);
                 auto
                     optMatch    = this->normEval(is, captures, usr_val);
                 is.SetPosition(iCurr);
 
                 if (!optMatch)
                     return Match{ iCurr, iCurr };
-                else
-                    return std::nullopt;
+
+                RecordFailure(iCurr);
+                return std::nullopt;
             }
 
             bool
@@ -169,25 +529,63 @@ namespace patt {
         class StringPattern :
             public Pattern {
         public:
+            friend class JitCompiler;
+
             StringPattern(std::string_view strv) :
                 str(strv) {}
             
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<StringPattern>(*this);
+                return MakePattern<StringPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this) + this->str.size();
             }
 
         private:
+            size_t
+            hashNode() const override {
+                return std::hash<std::string>{}(this->str);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const StringPattern&>(other);
+                return this->str == that.str;
+            }
+
+            FirstSet
+            normFirst() const override {
+                if (this->str.empty())
+                    return FirstSet{ .bNullable = true };
+
+                FirstSet
+                    first;
+                first.bsBytes.set((unsigned char)this->str.front());
+                return first;
+            }
+
+            LiteralPrefix
+            normPrefix() const override {
+                return LiteralPrefix{ this->str, true };
+            }
+
             OptMatch
             normEval(io::IStream &is, CaptureList&, const std::any&) const override {
                 intptr_t
                     iBegin  = is.GetPosition();
         
-                for (char c : this->str) {
+                for (size_t i = 0; i != this->str.size(); ++i) {
                     auto optc = is.Read();
-                    if (!optc || (char)*optc != c)
+                    if (!optc || (char)*optc != this->str[i]) {
+                        RecordFailure(iBegin + (intptr_t)i);
                         return std::nullopt;
+                    }
                 }
         
                 intptr_t
@@ -210,10 +608,41 @@ namespace patt {
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<SetPattern>(*this);
+                return MakePattern<SetPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this) + this->setChars.size();
             }
 
         private:
+            size_t
+            hashNode() const override {
+                size_t
+                    uHash   = 0;
+                for (char c : this->setChars)
+                    uHash   = HashCombine(uHash, (size_t)(unsigned char)c);
+                return uHash;
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const SetPattern&>(other);
+                return this->setChars == that.setChars;
+            }
+
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first;
+                for (char c : this->setChars)
+                    first.bsBytes.set((unsigned char)c);
+                return first;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList&, const std::any&) const override {
                 intptr_t
@@ -224,8 +653,10 @@ namespace patt {
                         iEnd    = is.GetPosition();
                     return Match{ iBegin, iEnd };
                 }
-                else
+                else {
+                    RecordFailure(iBegin);
                     return std::nullopt;
+                }
             }
 
             std::flat_set<char>
@@ -235,16 +666,70 @@ namespace patt {
         class ConcatPattern :
             public __impl::Pattern {
         public:
-            ConcatPattern(const patt::Pattern& lhs, const patt::Pattern& rhs) :
-                lhs(lhs), rhs(rhs) {}
+            friend class JitCompiler;
+
+            ConcatPattern(patt::Pattern lhs, patt::Pattern rhs) :
+                lhs(std::move(lhs)), rhs(std::move(rhs)) {}
 
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<ConcatPattern>(*this);
+                return MakePattern<ConcatPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->lhs);
+                fnVisit(this->rhs);
             }
         
         private:
+            size_t
+            hashNode() const override {
+                return HashCombine(std::hash<patt::Pattern>{}(this->lhs), std::hash<patt::Pattern>{}(this->rhs));
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const ConcatPattern&>(other);
+                return this->lhs == that.lhs && this->rhs == that.rhs;
+            }
+
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first   = this->lhs->First();
+                if (first.bNullable) {
+                    FirstSet
+                        firstRhs    = this->rhs->First();
+                    first.bsBytes   |= firstRhs.bsBytes;
+                    first.bNullable = firstRhs.bNullable;
+                    first.bHandlers = first.bHandlers || firstRhs.bHandlers;
+                }
+                return first;
+            }
+
+            LiteralPrefix
+            normPrefix() const override {
+                LiteralPrefix
+                    prefix  = this->lhs->Prefix();
+                if (!prefix.bExact)
+                    return prefix;
+
+                LiteralPrefix
+                    prefixRhs   = this->rhs->Prefix();
+                prefix.str      += prefixRhs.str;
+                prefix.bExact   = prefixRhs.bExact;
+                return prefix;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 auto
@@ -266,8 +751,8 @@ namespace patt {
 
         // lhs followed by rhs
         [[nodiscard]] inline patt::Pattern
-        operator>>(const patt::Pattern& lhs, const patt::Pattern& rhs) {
-            return std::make_shared<ConcatPattern>(lhs, rhs);
+        operator>>(patt::Pattern lhs, patt::Pattern rhs) {
+            return MakePattern<ConcatPattern>(std::move(lhs), std::move(rhs));
         }
 
         // lhs excluding rhs
@@ -290,17 +775,40 @@ namespace patt {
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<AnyPattern>(*this);
+                return MakePattern<AnyPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
             }
         
         private:
+            size_t
+            hashNode() const override {
+                return 0;
+            }
+
+            bool
+            equalNode(const Pattern&) const override {
+                return true;
+            }
+
+            FirstSet
+            normFirst() const override {
+                return FirstSet{ .bsBytes = ByteSet{}.set() };
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList&, const std::any&) const override {
                 intptr_t
                     iBegin  = is.GetPosition();
                 
-                if (!is.Read())
+                if (!is.Read()) {
+                    RecordFailure(iBegin);
                     return std::nullopt;
+                }
                 
                 intptr_t
                     iEnd    = is.GetPosition();
@@ -308,59 +816,259 @@ namespace patt {
             }
         };
 
+        // alternatives of a choice chain, indexed by the byte they may start with
+        struct ChoiceDispatch {
+            std::vector<patt::Pattern>
+                vecAlternatives;
+            // alternatives viable for byte c are vecIndices[arrStarts[c] .. arrStarts[c + 1]),
+            //  slot 256 stands for the end of input
+            std::array<uint32_t, 258>
+                arrStarts;
+            std::vector<uint32_t>
+                vecIndices;
+            // every alternative is viable for any byte, looking ahead won't help
+            bool
+                bTrivial;
+        };
+
+        // result of an analysis looking through grammar rules, built on first use and
+        //  again once one of those rules is redefined; copies build their own. Results
+        //  are handed out as snapshots, a superseded one lives as long as an evaluation
+        //  still holds it
+        template<typename T>
+        class LazyAnalysis {
+        public:
+            LazyAnalysis() = default;
+            LazyAnalysis(const LazyAnalysis&) {}
+
+            LazyAnalysis&
+            operator=(const LazyAnalysis&) {
+                this->Reset();
+                return *this;
+            }
+
+            template<typename Fn>
+            std::shared_ptr<const T>
+            Get(Fn&& fnBuild) const {
+                // 0 stands for never checked
+                uint64_t
+                    uGeneration = RuleGeneration().load(std::memory_order_acquire) + 1;
+                if (this->uChecked.load(std::memory_order_acquire) == uGeneration)
+                    return this->lpCurrent.load(std::memory_order_acquire);
+
+                std::lock_guard
+                    lock(this->mutex);
+                std::shared_ptr<const T>
+                    lpResult    = this->lpCurrent.load(std::memory_order_relaxed);
+                if (this->uChecked.load(std::memory_order_relaxed) == uGeneration)
+                    return lpResult;
+
+                // some rule changed, not necessarily one looked through here
+                if (lpResult == nullptr || !this->stamps.Current()) {
+                    FirstContext
+                        context;
+                    FirstScope
+                        scope(context);
+                    lpResult        = fnBuild();
+                    this->stamps    = context.Stamps();
+                    this->lpCurrent.store(lpResult, std::memory_order_release);
+                }
+                this->uChecked.store(uGeneration, std::memory_order_release);
+                return lpResult;
+            }
+
+            // forget the result, the next Get() builds a new one
+            void
+            Reset() {
+                std::lock_guard
+                    lock(this->mutex);
+                this->lpCurrent.store(nullptr, std::memory_order_relaxed);
+                this->uChecked.store(0, std::memory_order_release);
+            }
+
+        private:
+            mutable std::mutex
+                mutex;
+            mutable std::atomic<uint64_t>
+                uChecked    = 0;
+            mutable std::atomic<std::shared_ptr<const T>>
+                lpCurrent;
+            mutable RuleStamps
+                stamps;
+        };
+
         class ChoicePattern :
             public  Pattern {
         public:
-            ChoicePattern(const patt::Pattern& lhs, const patt::Pattern& rhs) :
-                lhs(lhs), rhs(rhs) {}
+            friend class JitCompiler;
+
+            ChoicePattern(patt::Pattern lhs, patt::Pattern rhs) :
+                lhs(std::move(lhs)), rhs(std::move(rhs)) {}
         
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<ChoicePattern>(*this);
+                return MakePattern<ChoicePattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->lhs);
+                fnVisit(this->rhs);
             }
         
         private:
+            size_t
+            hashNode() const override {
+                return HashCombine(std::hash<patt::Pattern>{}(this->lhs), std::hash<patt::Pattern>{}(this->rhs));
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const ChoicePattern&>(other);
+                return this->lhs == that.lhs && this->rhs == that.rhs;
+            }
+
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first   = this->lhs->First();
+                return first |= this->rhs->First();
+            }
+
+            // a |= b |= c is tried as one list of alternatives
+            void
+            flatten(std::vector<patt::Pattern>& vecAlternatives) const {
+                for (const patt::Pattern* lpPattern : { &this->lhs, &this->rhs }) {
+                    auto
+                        lpChoice    = dynamic_cast<const ChoicePattern*>(lpPattern->get());
+                    if (lpChoice != nullptr && !lpChoice->bNegated)
+                        lpChoice->flatten(vecAlternatives);
+                    else
+                        vecAlternatives.push_back(*lpPattern);
+                }
+            }
+
+            std::shared_ptr<const ChoiceDispatch>
+            buildDispatch() const {
+                auto
+                    lpDispatch  = std::make_shared<ChoiceDispatch>();
+                this->flatten(lpDispatch->vecAlternatives);
+
+                std::vector<FirstSet>
+                    vecFirst;
+                lpDispatch->bTrivial    = true;
+                for (const auto& alternative : lpDispatch->vecAlternatives) {
+                    vecFirst.push_back(alternative->First());
+                    // skipping would skip the handlers run before the first byte is read
+                    if (vecFirst.back().bHandlers)
+                        vecFirst.back().bNullable   = true;
+                    lpDispatch->bTrivial    = lpDispatch->bTrivial
+                        && (vecFirst.back().bNullable || vecFirst.back().bsBytes.all());
+                }
+
+                for (size_t uSlot = 0; uSlot != 257; ++uSlot) {
+                    lpDispatch->arrStarts[uSlot] = (uint32_t)lpDispatch->vecIndices.size();
+                    for (size_t i = 0; i != vecFirst.size(); ++i) {
+                        bool
+                            bViable = (uSlot != 256)
+                                ? vecFirst[i].Accepts((std::byte)uSlot)
+                                : vecFirst[i].Accepts(std::nullopt);
+                        if (bViable)
+                            lpDispatch->vecIndices.push_back((uint32_t)i);
+                    }
+                }
+                lpDispatch->arrStarts[257] = (uint32_t)lpDispatch->vecIndices.size();
+                return lpDispatch;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
+                // held for the whole evaluation, a rule may be redefined by a handler meanwhile
+                std::shared_ptr<const ChoiceDispatch>
+                    lpDispatch  = this->lazyDispatch.Get([this]() {
+                        return this->buildDispatch();
+                    });
+                const ChoiceDispatch&
+                    dispatch    = *lpDispatch;
+
                 intptr_t
                     iBegin      = is.GetPosition();
-                CaptureList
-                    local_captures;
-                OptMatch
-                    optMatch    = this->lhs->Eval(is, local_captures, usr_val);
-                
-                if (optMatch) {
-                    intptr_t
-                        iEnd    = is.GetPosition();
-                    for (const auto& m : local_captures) {
-                        captures.push_back(m);
-                    }
-                    return Match{ iBegin, iEnd };
-                }
-                else
+                BacktrackPoint
+                    backtrack(is, iBegin);
+
+                // skip the alternatives that can't start with the next byte
+                size_t
+                    uSlot       = 0;
+                if (!dispatch.bTrivial) {
+                    auto
+                        optc    = is.Read();
+                    uSlot       = (optc) ? (size_t)*optc : 256;
                     is.SetPosition(iBegin);
-                
-                optMatch        = this->rhs->Eval(is, captures, usr_val);
-                if (optMatch) {
-                    intptr_t
-                        iEnd    = is.GetPosition();
-                    return Match{ iBegin, iEnd };
                 }
-                else {
-                    is.SetPosition(iBegin);
-                    return std::nullopt;
+
+                std::span<const uint32_t>
+                    spanViable(
+                        dispatch.vecIndices.data() + dispatch.arrStarts[uSlot],
+                        dispatch.vecIndices.data() + dispatch.arrStarts[uSlot + 1]);
+                // an alternative skipped before the one tried next would have failed right here
+                uint32_t
+                    uNext       = 0;
+                for (uint32_t uIndex : spanViable) {
+                    const patt::Pattern&
+                        alternative = dispatch.vecAlternatives[uIndex];
+                    if (uIndex != uNext)
+                        RecordFailure(iBegin);
+                    uNext   = uIndex + 1;
+
+                    // the last alternative adds its captures directly, like the rhs of a single choice
+                    if (uIndex + 1 == dispatch.vecAlternatives.size()) {
+                        if (alternative->Eval(is, captures, usr_val)) {
+                            intptr_t
+                                iEnd    = is.GetPosition();
+                            return Match{ iBegin, iEnd };
+                        }
+
+                        is.SetPosition(iBegin);
+                        return std::nullopt;
+                    }
+
+                    CaptureList
+                        local_captures;
+                    if (alternative->Eval(is, local_captures, usr_val)) {
+                        intptr_t
+                            iEnd    = is.GetPosition();
+                        for (const auto& m : local_captures) {
+                            captures.push_back(m);
+                        }
+                        return Match{ iBegin, iEnd };
+                    }
+                    else
+                        is.SetPosition(iBegin);
                 }
+
+                if (uNext != dispatch.vecAlternatives.size())
+                    RecordFailure(iBegin);
+                return std::nullopt;
             }
 
             patt::Pattern
                 lhs, rhs;
+            LazyAnalysis<ChoiceDispatch>
+                lazyDispatch;
         };
 
         // ordered choice
         [[nodiscard]] inline patt::Pattern
-        operator|=(const patt::Pattern& lhs, const patt::Pattern& rhs) {
-            return std::make_shared<ChoicePattern>(lhs, rhs);
+        operator|=(patt::Pattern lhs, patt::Pattern rhs) {
+            return MakePattern<ChoicePattern>(std::move(lhs), std::move(rhs));
         }
 
         class HandlerPattern :
@@ -371,17 +1079,55 @@ namespace patt {
 
             template<typename Fn> requires
                 std::is_constructible_v<Callback, Fn>
-            HandlerPattern(const patt::Pattern& pattern, Fn&& fnCallback) :
-                pattern     (pattern),
+            HandlerPattern(patt::Pattern pattern, Fn&& fnCallback) :
+                pattern     (std::move(pattern)),
                 fnCallback  (std::forward<Fn>(fnCallback)) {}
         
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<HandlerPattern>(*this);
+                return MakePattern<HandlerPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->pattern);
             }
         
         private:
+            // callbacks can't be compared, so handlers are only ever equal to themselves
+            size_t
+            hashNode() const override {
+                return std::hash<const void*>{}(this);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                return this == &other;
+            }
+
+            // around a pattern that has to consume, the callback only runs before the
+            //  first byte is consumed when that byte doesn't fit, which a choice may skip
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first   = this->pattern->First();
+                first.bHandlers = first.bHandlers || first.bNullable;
+                return first;
+            }
+
+            LiteralPrefix
+            normPrefix() const override {
+                // the callback has to run, so the match is never exact
+                return LiteralPrefix{ this->pattern->Prefix().str, false };
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 OptMatch
@@ -401,9 +1147,9 @@ namespace patt {
             std::is_constructible_v<HandlerPattern::Callback, Fn>
         [[nodiscard]]
         inline patt::Pattern
-        operator/(const patt::Pattern& pattern, Fn&& fn) {
-            return std::make_shared<HandlerPattern>(
-                pattern, fn);
+        operator/(patt::Pattern pattern, Fn&& fn) {
+            return MakePattern<HandlerPattern>(
+                std::move(pattern), std::forward<Fn>(fn));
         }
 
         class LocalePattern :
@@ -418,10 +1164,39 @@ namespace patt {
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<LocalePattern>(*this);
+                return MakePattern<LocalePattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
             }
         
         private:
+            size_t
+            hashNode() const override {
+                return std::hash<LocaleProc>{}(this->lpfn);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const LocalePattern&>(other);
+                return this->lpfn == that.lpfn;
+            }
+
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first;
+                for (size_t c = 0; c != first.bsBytes.size(); ++c) {
+                    if (this->lpfn((int)c))
+                        first.bsBytes.set(c);
+                }
+                return first;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList&, const std::any&) const override {
                 intptr_t
@@ -429,8 +1204,10 @@ namespace patt {
                 
                 auto
                     optc    = is.Read();
-                if (!optc || !this->lpfn((int)*optc))
+                if (!optc || !this->lpfn((int)*optc)) {
+                    RecordFailure(iBegin);
                     return std::nullopt;
+                }
 
                 intptr_t
                     iEnd    = is.GetPosition();
@@ -441,37 +1218,127 @@ namespace patt {
                 lpfn;
         };
 
+        // intercepts evaluation of grammar rules and repetitions (see IncrementalParser)
+        class RuleMemo {
+        public:
+            virtual ~RuleMemo() = default;
+
+            virtual OptMatch
+            EvalRule(const void* lpRule, const patt::Pattern& pattern, io::IStream& is, CaptureList& captures, const std::any& usr_val) = 0;
+
+            // the next iterations of a repetition started at iRepeat: either one evaluated
+            //  or a run of remembered ones; returns how many matched, 0 if the body failed
+            virtual size_t
+            EvalIterations(const void* lpRepeat, intptr_t iRepeat, const patt::Pattern& body, io::IStream& is, CaptureList& captures, const std::any& usr_val) = 0;
+        };
+
+        inline RuleMemo*&
+        CurrentRuleMemo() noexcept {
+            static thread_local RuleMemo*
+                lpMemo  = nullptr;
+            return lpMemo;
+        }
+
+        // the pattern refers to a grammar rule somewhere in its tree (rules aren't followed)
+        inline bool
+        ReferencesRules(const Pattern& pattern);
+
         class RepeatPattern :
             public Pattern {
         public:
-            RepeatPattern(const patt::Pattern& pattern, size_t uCount) :
-                pattern(pattern), uCount(uCount) {}
+            friend class JitCompiler;
+            friend bool ReferencesRules(const Pattern&);
+
+            RepeatPattern(patt::Pattern pattern, size_t uCount) :
+                pattern (std::move(pattern)),
+                uCount  (uCount),
+                bRules  (ReferencesRules(*this->pattern)) {}
 
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<RepeatPattern>(*this);
+                return MakePattern<RepeatPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->pattern);
             }
 
         private:
+            size_t
+            hashNode() const override {
+                return HashCombine(std::hash<patt::Pattern>{}(this->pattern), this->uCount);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const RepeatPattern&>(other);
+                return this->pattern == that.pattern && this->uCount == that.uCount;
+            }
+
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first   = this->pattern->First();
+                first.bNullable =
+                    first.bNullable || this->uCount == 0;
+                return first;
+            }
+
+            // repeats 0..N times
+            FirstSet
+            negFirst() const override {
+                FirstSet
+                    first   = this->pattern->First();
+                first.bNullable = true;
+                return first;
+            }
+
+            // matches the body once, or a run of remembered iterations when a memo is installed;
+            //  only iterations made of grammar rules are worth remembering
+            size_t
+            evalIterations(intptr_t iBegin, io::IStream& is, CaptureList& captures, const std::any& usr_val) const {
+                RuleMemo*
+                    lpMemo  = (this->bRules) ? CurrentRuleMemo() : nullptr;
+                if (lpMemo != nullptr)
+                    return lpMemo->EvalIterations(this, iBegin, this->pattern, is, captures, usr_val);
+                return (this->pattern->Eval(is, captures, usr_val)) ? 1 : 0;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 intptr_t
-                    iBegin  = is.GetPosition();
-                for (size_t i = 0; i != this->uCount; ++i) {
-                    if (!this->pattern->Eval(is, captures, usr_val))
+                    iBegin      = is.GetPosition();
+                size_t
+                    uMatched    = 0;
+                while (uMatched < this->uCount) {
+                    size_t
+                        uRun    = this->evalIterations(iBegin, is, captures, usr_val);
+                    if (uRun == 0)
                         return std::nullopt;
+                    uMatched    += uRun;
                 }
 
                 intptr_t
                     iCurr   = is.GetPosition();
+                BacktrackPoint
+                    backtrack(is, iCurr);
                 while (true) {
-                    if (!this->pattern->Eval(is, captures, usr_val)) {
+                    if (this->evalIterations(iBegin, is, captures, usr_val) == 0) {
                         is.SetPosition(iCurr);
                         break;
                     }
 
                     iCurr   = is.GetPosition();
+                    backtrack.Move(iCurr);
                 }
 
                 return Match{ iBegin, iCurr };
@@ -481,9 +1348,12 @@ namespace patt {
             negEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 intptr_t
                     iBegin  = is.GetPosition();
+                BacktrackPoint
+                    backtrack(is, iBegin);
                 for (size_t i = 0; i != this->uCount; ++i) {
                     intptr_t
                         iCurr   = is.GetPosition();
+                    backtrack.Move(iCurr);
                     if (!this->pattern->Eval(is, captures, usr_val)) {
                         is.SetPosition(iCurr);
                         return Match{ iBegin, iCurr };
@@ -499,6 +1369,8 @@ namespace patt {
                 pattern;
             size_t
                 uCount;
+            bool
+                bRules;
         };
 
         // repeat pattern:
@@ -506,27 +1378,59 @@ namespace patt {
         //  if rhs is negative, repeat 0..N times.
         [[nodiscard]]
         inline patt::Pattern
-        operator%(const patt::Pattern& lhs, ssize_t rhs) {
+        operator%(patt::Pattern lhs, ssize_t rhs) {
             patt::Pattern
-                pattern = std::make_shared<RepeatPattern>(lhs, (size_t)std::abs(rhs));
+                pattern = MakePattern<RepeatPattern>(std::move(lhs), (size_t)std::abs(rhs));
             if (rhs < 0)
-                pattern = -pattern;
+                pattern = -std::move(pattern);
             return pattern;
         }
 
         class RepeatExactPattern :
             public Pattern {
         public:
-            RepeatExactPattern(const patt::Pattern& pattern, size_t uCount) :
-                pattern(pattern), uCount(uCount) {}
+            friend class JitCompiler;
+
+            RepeatExactPattern(patt::Pattern pattern, size_t uCount) :
+                pattern(std::move(pattern)), uCount(uCount) {}
 
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<RepeatExactPattern>(*this);
+                return MakePattern<RepeatExactPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->pattern);
             }
         
         private:
+            size_t
+            hashNode() const override {
+                return HashCombine(std::hash<patt::Pattern>{}(this->pattern), this->uCount);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const RepeatExactPattern&>(other);
+                return this->pattern == that.pattern && this->uCount == that.uCount;
+            }
+
+            FirstSet
+            normFirst() const override {
+                if (this->uCount == 0)
+                    return FirstSet{ .bNullable = true };
+                return this->pattern->First();
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 intptr_t
@@ -550,12 +1454,12 @@ namespace patt {
         // repeat pattern exactly N times
         [[nodiscard]]
         inline patt::Pattern
-        operator*(const patt::Pattern& lhs, size_t rhs) {
-            return std::make_shared<RepeatExactPattern>(lhs, rhs);
+        operator*(patt::Pattern lhs, size_t rhs) {
+            return MakePattern<RepeatExactPattern>(std::move(lhs), rhs);
         }
 
         using MapPatterns =
-            std::map<std::string, patt::Pattern>;
+            std::map<std::string, Rule>;
 
         class Grammar {
         private:
@@ -564,8 +1468,10 @@ namespace patt {
                 Accessor(MapPatterns& mapPatterns, const std::string& strKey) {
                     auto
                         it  = mapPatterns.find(strKey);
-                    if (it == mapPatterns.end())
-                        it  = mapPatterns.emplace(strKey, nullptr).first;
+                    if (it == mapPatterns.end()) {
+                        it  = mapPatterns.emplace(strKey, Rule{}).first;
+                        it->second.Restamp();
+                    }
                     this->itPattern = it;
                 }
 
@@ -574,7 +1480,9 @@ namespace patt {
 
                 patt::Pattern&
                 operator=(const patt::Pattern& pattern) && {
-                    return this->itPattern->second = pattern;
+                    this->itPattern->second.pattern = pattern;
+                    this->itPattern->second.Restamp();
+                    return this->itPattern->second.pattern;
                 }
             private:
                 MapPatterns::iterator
@@ -609,6 +1517,25 @@ namespace patt {
                 return Accessor(this->mapPatterns, strKey);
             }
 
+            // visit (and possibly replace) every rule pattern
+            template<typename Fn> requires
+                std::is_invocable_v<Fn, const std::string&, patt::Pattern&>
+            void
+            ForEachRule(Fn&& fn) {
+                for (auto& [strKey, rule] : this->mapPatterns) {
+                    fn(strKey, rule.pattern);
+                    rule.Restamp();
+                }
+            }
+
+            template<typename Fn> requires
+                std::is_invocable_v<Fn, const std::string&, const patt::Pattern&>
+            void
+            ForEachRule(Fn&& fn) const {
+                for (const auto& [strKey, rule] : this->mapPatterns)
+                    fn(strKey, rule.pattern);
+            }
+
         private:
             MapPatterns
                 mapPatterns;
@@ -623,16 +1550,73 @@ namespace patt {
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<GrammarPattern>(*this);
+                return MakePattern<GrammarPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
             }
 
         private:
+            // rules are referenced, not owned, so they're compared by identity
+            size_t
+            hashNode() const override {
+                return std::hash<const void*>{}(&*this->itPattern);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const GrammarPattern&>(other);
+                return this->itPattern == that.itPattern;
+            }
+
+            FirstSet
+            normFirst() const override {
+                const FirstSet
+                    firstAny    = { .bsBytes = ByteSet{}.set(), .bNullable = true };
+                const Rule&
+                    rule        = this->itPattern->second;
+                FirstContext&
+                    context     = *CurrentFirstContext();
+                context.Record(rule);
+
+                // an undefined rule may still be defined later
+                if (rule.pattern == nullptr)
+                    return firstAny;
+
+                const void*
+                    lpRule  = &rule;
+                auto
+                    it      = context.mapRules.find(lpRule);
+                if (it != context.mapRules.end())
+                    return it->second;
+
+                // left recursion, nothing is known yet
+                if (!context.setActive.insert(lpRule).second) {
+                    FirstSet
+                        first   = firstAny;
+                    first.bHandlers = true;
+                    return first;
+                }
+
+                FirstSet
+                    first   = rule.pattern->First();
+                context.setActive.erase(lpRule);
+                context.mapRules.emplace(lpRule, first);
+                return first;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 const patt::Pattern&
-                    pattern = this->itPattern->second;
+                    pattern = this->itPattern->second.pattern;
                 if (pattern == nullptr)
                     return std::nullopt;
+                if (RuleMemo* lpMemo = CurrentRuleMemo())
+                    return lpMemo->EvalRule(&*this->itPattern, pattern, is, captures, usr_val);
                 return pattern->Eval(is, captures, usr_val);
             }
 
@@ -641,23 +1625,73 @@ namespace patt {
         };
 
         inline Grammar::Accessor::operator patt::Pattern() && {
-            return std::make_shared<GrammarPattern>(
+            return MakePattern<GrammarPattern>(
                 this->itPattern);
         }
 
+        inline bool
+        ReferencesRules(const Pattern& pattern) {
+            if (dynamic_cast<const GrammarPattern*>(&pattern) != nullptr)
+                return true;
+            if (auto lpRepeat = dynamic_cast<const RepeatPattern*>(&pattern))
+                return lpRepeat->bRules;
+
+            // the visitor only reads the children
+            bool
+                bFound  = false;
+            const_cast<Pattern&>(pattern).VisitChildren([&](patt::Pattern& child) {
+                bFound  = bFound || ReferencesRules(*child);
+            });
+            return bFound;
+        }
+
         class CapturePattern :
             public Pattern {
         public:
-            CapturePattern(const patt::Pattern& pattern) :
-                pattern(pattern) {}
+            CapturePattern(patt::Pattern pattern) :
+                pattern(std::move(pattern)) {}
         
             [[nodiscard]]
             patt::Pattern
             Clone() const override {
-                return std::make_shared<CapturePattern>(*this);
+                return MakePattern<CapturePattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->pattern);
             }
 
         private:
+            size_t
+            hashNode() const override {
+                return std::hash<patt::Pattern>{}(this->pattern);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const CapturePattern&>(other);
+                return this->pattern == that.pattern;
+            }
+
+            FirstSet
+            normFirst() const override {
+                return this->pattern->First();
+            }
+
+            LiteralPrefix
+            normPrefix() const override {
+                // the match has to be captured, so it's never exact
+                return LiteralPrefix{ this->pattern->Prefix().str, false };
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 OptMatch
@@ -674,19 +1708,55 @@ namespace patt {
         class LookAheadPattern :
             public Pattern {
         public:
-            LookAheadPattern(const patt::Pattern& pattern) :
-                pattern(pattern) {}
+            friend class JitCompiler;
+
+            LookAheadPattern(patt::Pattern pattern) :
+                pattern(std::move(pattern)) {}
 
             patt::Pattern
             Clone() const override {
-                return std::make_shared<LookAheadPattern>(*this);
+                return MakePattern<LookAheadPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+            void
+            VisitChildren(const std::function<void(patt::Pattern&)>& fnVisit) override {
+                fnVisit(this->pattern);
             }
 
         private:
+            size_t
+            hashNode() const override {
+                return std::hash<patt::Pattern>{}(this->pattern);
+            }
+
+            bool
+            equalNode(const Pattern& other) const override {
+                const auto&
+                    that    = static_cast<const LookAheadPattern&>(other);
+                return this->pattern == that.pattern;
+            }
+
+            // never consumes anything
+            FirstSet
+            normFirst() const override {
+                FirstSet
+                    first   = this->pattern->First();
+                first.bNullable = true;
+                return first;
+            }
+
             OptMatch
             normEval(io::IStream& is, CaptureList& captures, const std::any& usr_val) const override {
                 intptr_t
                     iCurr       = is.GetPosition();
+                BacktrackPoint
+                    backtrack(is, iCurr);
                 auto
                     optMatch    = this->pattern->Eval(is, captures, usr_val);
                 is.SetPosition(iCurr);
@@ -699,27 +1769,29 @@ namespace patt {
         };
 
         inline patt::Pattern
-        operator&(const patt::Pattern& pattern) {
-            return std::make_shared<LookAheadPattern>(pattern);
+        operator&(patt::Pattern pattern) {
+            return MakePattern<LookAheadPattern>(std::move(pattern));
         }
     }
 
     [[nodiscard]]
     inline Pattern
-    Capt(const patt::Pattern& pattern) {
-        return std::make_shared<__impl::CapturePattern>(pattern);
+    Capt(patt::Pattern pattern) {
+        return __impl::MakePattern<__impl::CapturePattern>(std::move(pattern));
     }
 
     [[nodiscard]]
     inline Pattern
     Str(std::string_view strv) {
-        return std::make_shared<__impl::StringPattern>(strv);
+        return __impl::MakePattern<__impl::StringPattern>(strv);
     }
 
     [[nodiscard]]
     inline Pattern
     Any() {
-        return std::make_shared<__impl::AnyPattern>();
+        static const Pattern
+            pattern = std::make_shared<__impl::AnyPattern>();
+        return pattern;
     }
 
     [[nodiscard]]
@@ -731,55 +1803,71 @@ namespace patt {
     [[nodiscard]]
     inline Pattern
     Alpha() {
-        return std::make_shared<__impl::LocalePattern>(isalpha);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isalpha);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     Alnum() {
-        return std::make_shared<__impl::LocalePattern>(isalnum);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isalnum);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     Digit() {
-        return std::make_shared<__impl::LocalePattern>(isdigit);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isdigit);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     HexDigit() {
-        return std::make_shared<__impl::LocalePattern>(isxdigit);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isxdigit);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     LowerCase() {
-        return std::make_shared<__impl::LocalePattern>(islower);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(islower);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     UpperCase() {
-        return std::make_shared<__impl::LocalePattern>(isupper);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isupper);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     SpaceOrNewLine() {
-        return std::make_shared<__impl::LocalePattern>(isspace);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isspace);
+        return pattern;
     }
 
     [[nodiscard]]
     inline Pattern
     Blank() {
-        return std::make_shared<__impl::LocalePattern>(isblank);
+        static const Pattern
+            pattern = std::make_shared<__impl::LocalePattern>(isblank);
+        return pattern;
     }
     
     [[nodiscard]]
     inline Pattern
     Set(std::string_view strvSet) {
-        return std::make_shared<__impl::SetPattern>(strvSet);
+        return __impl::MakePattern<__impl::SetPattern>(strvSet);
     }
 
     [[nodiscard]]
@@ -788,9 +1876,279 @@ namespace patt {
         return Set(" \t\v");
     }
 
+    struct PatternStats {
+        size_t
+            uNodes  = 0,
+            uBytes  = 0;
+    };
+
+    namespace __impl {
+        inline void
+        CollectStats(const patt::Pattern& pattern, std::unordered_set<const Pattern*>& setVisited, PatternStats& stats) {
+            if (pattern == nullptr || !setVisited.insert(pattern.get()).second)
+                return;
+
+            stats.uNodes    += 1;
+            stats.uBytes    += pattern->Footprint();
+            pattern->VisitChildren([&](patt::Pattern& child) {
+                CollectStats(child, setVisited, stats);
+            });
+        }
+    }
+
+    // count distinct nodes reachable from the pattern (grammar rules are not followed)
+    [[nodiscard]]
+    inline PatternStats
+    Stats(const Pattern& pattern) {
+        std::unordered_set<const __impl::Pattern*>
+            setVisited;
+        PatternStats
+            stats;
+        __impl::CollectStats(pattern, setVisited, stats);
+        return stats;
+    }
+
+    // count distinct nodes over all the grammar rules
+    [[nodiscard]]
+    inline PatternStats
+    Stats(const Grammar& grammar) {
+        std::unordered_set<const __impl::Pattern*>
+            setVisited;
+        PatternStats
+            stats;
+        grammar.ForEachRule([&](const std::string&, const Pattern& pattern) {
+            __impl::CollectStats(pattern, setVisited, stats);
+        });
+        return stats;
+    }
+
+    // hash-consing of pattern nodes: structurally identical subtrees are
+    // replaced by a single shared node. The pool keeps interned nodes alive.
+    class PatternPool {
+    public:
+        PatternPool() = default;
+
+        [[nodiscard]]
+        Pattern
+        Intern(const Pattern& pattern) {
+            MapMemo
+                mapMemo;
+            return this->intern(pattern, mapMemo);
+        }
+
+        void
+        Intern(Grammar& grammar) {
+            MapMemo
+                mapMemo;
+            grammar.ForEachRule([&](const std::string&, Pattern& pattern) {
+                pattern = this->intern(pattern, mapMemo);
+            });
+        }
+
+        [[nodiscard]]
+        size_t
+        Size() const noexcept {
+            return this->mapNodes.size();
+        }
+
+        [[nodiscard]]
+        PatternStats
+        Stats() const {
+            PatternStats
+                stats;
+            for (const auto& [uHash, pattern] : this->mapNodes) {
+                stats.uNodes    += 1;
+                stats.uBytes    += pattern->Footprint();
+            }
+            return stats;
+        }
+
+        void
+        Clear() noexcept {
+            this->mapNodes.clear();
+        }
+
+    private:
+        using MapMemo =
+            std::unordered_map<const __impl::Pattern*, Pattern>;
+
+        Pattern
+        intern(const Pattern& pattern, MapMemo& mapMemo) {
+            if (pattern == nullptr)
+                return nullptr;
+
+            auto
+                itMemo  = mapMemo.find(pattern.get());
+            if (itMemo != mapMemo.end())
+                return itMemo->second;
+
+            // children go first, so the node may compare them by address
+            std::vector<Pattern>
+                vecChildren;
+            bool
+                bChanged    = false;
+            pattern->VisitChildren([&](Pattern& child) {
+                vecChildren.push_back(
+                    this->intern(child, mapMemo));
+                bChanged    = bChanged || vecChildren.back() != child;
+            });
+
+            Pattern
+                node    = pattern;
+            if (bChanged) {
+                node    = pattern->Clone();
+                auto
+                    itChild = vecChildren.begin();
+                node->VisitChildren([&](Pattern& child) {
+                    child   = std::move(*itChild++);
+                });
+            }
+
+            size_t
+                uHash   = node->Hash();
+            auto
+                [itBegin, itEnd]    = this->mapNodes.equal_range(uHash);
+            auto
+                itFound = std::find_if(itBegin, itEnd, [&](const auto& entry) {
+                    return entry.second->Equals(*node);
+                });
+
+            if (itFound != itEnd)
+                node    = itFound->second;
+            else
+                this->mapNodes.emplace(uHash, node);
+
+            mapMemo.emplace(pattern.get(), node);
+            return node;
+        }
+
+        std::unordered_multimap<size_t, Pattern>
+            mapNodes;
+    };
+
+    // owns the memory of every node built while one of its scopes is active:
+    //  nodes and their control blocks are laid out contiguously and released
+    //  all at once. Every node holds a reference to the arena's memory, so
+    //  handles kept past the arena (by a PatternPool, PatternSet, JitPattern,
+    //  IncrementalParser, ...) stay valid, and the memory goes with the last
+    //  of them; Live() tells how many nodes are still referenced.
+    //  Character-class singletons (Alpha(), Any(), ...) are never arena-allocated.
+    class PatternArena {
+    public:
+        class Scope {
+        public:
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            ~Scope() {
+                __impl::CurrentResource() =
+                    std::move(this->lpPrevious);
+            }
+
+        private:
+            friend class PatternArena;
+
+            Scope(std::shared_ptr<std::pmr::memory_resource> lpResource) :
+                lpPrevious(std::exchange(__impl::CurrentResource(), std::move(lpResource))) {}
+
+            std::shared_ptr<std::pmr::memory_resource>
+                lpPrevious;
+        };
+
+        PatternArena(size_t uInitialSize = 4096) :
+            lpResource(std::make_shared<CountingResource>(uInitialSize)) {}
+
+        PatternArena(const PatternArena&) = delete;
+        PatternArena& operator=(const PatternArena&) = delete;
+
+        // allocate nodes from this arena until the returned scope is destroyed
+        [[nodiscard]]
+        Scope
+        Use() {
+            return Scope(this->lpResource);
+        }
+
+        // nodes built in the arena that are still referenced
+        [[nodiscard]]
+        size_t
+        Live() const noexcept {
+            return this->lpResource->uLive.load(std::memory_order_relaxed);
+        }
+
+    private:
+        // monotonic allocation, counting the blocks not released yet
+        class CountingResource :
+            public std::pmr::memory_resource {
+        public:
+            CountingResource(size_t uInitialSize) :
+                upstream(uInitialSize) {}
+
+            std::atomic<size_t>
+                uLive   = 0;
+
+        private:
+            void*
+            do_allocate(size_t uBytes, size_t uAlignment) override {
+                void*
+                    lpBlock = this->upstream.allocate(uBytes, uAlignment);
+                this->uLive.fetch_add(1, std::memory_order_relaxed);
+                return lpBlock;
+            }
+
+            void
+            do_deallocate(void* lpBlock, size_t uBytes, size_t uAlignment) override {
+                this->uLive.fetch_sub(1, std::memory_order_relaxed);
+                this->upstream.deallocate(lpBlock, uBytes, uAlignment);
+            }
+
+            bool
+            do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+                return this == &other;
+            }
+
+            std::pmr::monotonic_buffer_resource
+                upstream;
+        };
+
+        std::shared_ptr<CountingResource>
+            lpResource;
+    };
+
     [[nodiscard]]
     inline OptMatch
     Eval(const Pattern& p, io::IStream& is, CaptureList& captures, const std::any& usr_val = {}) {
         return p->Eval(is, captures, usr_val);
     }
+
+    // farthest position any terminal failed to match at during an evaluation
+    struct Failure {
+        intptr_t
+            iPosition   = -1;
+
+        [[nodiscard]]
+        bool
+        Any() const noexcept {
+            return this->iPosition >= 0;
+        }
+    };
+
+    // evaluate, also reporting where the input stopped matching
+    [[nodiscard]]
+    inline OptMatch
+    Eval(const Pattern& p, io::IStream& is, CaptureList& captures, Failure& failure, const std::any& usr_val = {}) {
+        intptr_t*
+            lpPrevious  = std::exchange(__impl::CurrentFailure(), &failure.iPosition);
+        OptMatch
+            optMatch;
+        try {
+            optMatch    = p->Eval(is, captures, usr_val);
+        }
+        catch (...) {
+            __impl::CurrentFailure() = lpPrevious;
+            throw;
+        }
+
+        __impl::CurrentFailure() = lpPrevious;
+        return optMatch;
+    }
 }
@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+#include "Patterns.hpp"
+
+namespace patt {
+    // a seekable view of a forward-only stream (a socket, a pipe, stdin):
+    //  bytes read from the source are kept in a ring buffer until they are
+    //  committed. Commit() never discards bytes the evaluator may still rewind
+    //  to, so memory is bounded by how far back the grammar actually looks,
+    //  not by the input size. Matches must be read (GetString, Forward) before
+    //  their bytes are committed.
+    //
+    //  The window knows the backtrack points of evaluations running on it directly;
+    //  when it's wrapped in another stream, commit only between evaluations.
+    class WindowStream :
+        public io::IStream,
+        public __impl::TrackedStream {
+    public:
+        WindowStream(io::IStream& source, size_t uInitialCapacity = 4096) :
+            source  (source),
+            iBase   (source.GetPosition()),
+            iPos    (iBase) {
+            size_t
+                uCapacity   = 1;
+            while (uCapacity < uInitialCapacity)
+                uCapacity   <<= 1;
+            this->vecRing.resize(uCapacity);
+        }
+
+        std::optional<std::byte>
+        Read() override {
+            if (this->iPos == this->End()) {
+                auto
+                    optc    = this->source.Read();
+                if (!optc)
+                    return std::nullopt;
+                this->push(*optc);
+            }
+
+            size_t
+                uIndex  = this->uHead + (size_t)(this->iPos - this->iBase);
+            this->iPos  += 1;
+            return this->vecRing[uIndex & (this->vecRing.size() - 1)];
+        }
+
+        intptr_t
+        GetPosition() override {
+            return this->iPos;
+        }
+
+        // positions before the committed offset are gone;
+        //  positions past the buffered bytes are read from the source
+        void
+        SetPosition(intptr_t iPosition) override {
+            if (iPosition < this->iBase)
+                throw std::out_of_range("patt::WindowStream: position was already committed");
+
+            while (this->End() < iPosition) {
+                auto
+                    optc    = this->source.Read();
+                if (!optc)
+                    break;
+                this->push(*optc);
+            }
+            this->iPos  = std::min(iPosition, this->End());
+        }
+
+        // declare that nothing before iOffset will be read again;
+        //  backtrack points still alive keep their bytes around
+        void
+        Commit(intptr_t iOffset) noexcept {
+            iOffset = std::min(iOffset, this->iPos);
+            if (!this->vecBacktrack.empty())
+                iOffset = std::min(iOffset, this->vecBacktrack.front());
+            if (iOffset <= this->iBase)
+                return;
+
+            size_t
+                uDiscard    = (size_t)(iOffset - this->iBase);
+            this->uHead     = (this->uHead + uDiscard) & (this->vecRing.size() - 1);
+            this->uSize     -= uDiscard;
+            this->iBase     = iOffset;
+        }
+
+        // commit everything before the current position
+        void
+        Commit() noexcept {
+            this->Commit(this->iPos);
+        }
+
+        // oldest position that can still be rewound to
+        [[nodiscard]]
+        intptr_t
+        Base() const noexcept {
+            return this->iBase;
+        }
+
+        [[nodiscard]]
+        size_t
+        Buffered() const noexcept {
+            return this->uSize;
+        }
+
+        [[nodiscard]]
+        size_t
+        Capacity() const noexcept {
+            return this->vecRing.size();
+        }
+
+    private:
+        intptr_t
+        End() const noexcept {
+            return this->iBase + (intptr_t)this->uSize;
+        }
+
+        void
+        push(std::byte c) {
+            if (this->uSize == this->vecRing.size())
+                this->grow();
+
+            size_t
+                uMask   = this->vecRing.size() - 1;
+            this->vecRing[(this->uHead + this->uSize) & uMask] = c;
+            this->uSize += 1;
+        }
+
+        void
+        grow() {
+            std::vector<std::byte>
+                vecGrown(this->vecRing.size() * 2);
+            size_t
+                uMask   = this->vecRing.size() - 1;
+            for (size_t i = 0; i != this->uSize; ++i)
+                vecGrown[i] = this->vecRing[(this->uHead + i) & uMask];
+
+            this->vecRing.swap(vecGrown);
+            this->uHead = 0;
+        }
+
+        io::IStream&
+            source;
+        std::vector<std::byte>
+            vecRing;
+        size_t
+            uHead   = 0,
+            uSize   = 0;
+        intptr_t
+            iBase,
+            iPos;
+    };
+
+    namespace __impl {
+        class CommitPattern :
+            public Pattern {
+        public:
+            CommitPattern() = default;
+
+            [[nodiscard]]
+            patt::Pattern
+            Clone() const override {
+                return MakePattern<CommitPattern>(*this);
+            }
+
+            [[nodiscard]]
+            size_t
+            Footprint() const override {
+                return sizeof(*this);
+            }
+
+        private:
+            size_t
+            hashNode() const override {
+                return 0;
+            }
+
+            bool
+            equalNode(const Pattern&) const override {
+                return true;
+            }
+
+            FirstSet
+            normFirst() const override {
+                return FirstSet{ .bNullable = true };
+            }
+
+            OptMatch
+            normEval(io::IStream& is, CaptureList&, const std::any&) const override {
+                intptr_t
+                    iCurr   = is.GetPosition();
+                if (auto lpWindow = dynamic_cast<WindowStream*>(&is))
+                    lpWindow->Commit(iCurr);
+                return Match{ iCurr, iCurr };
+            }
+        };
+    }
+
+    // always matches, consuming nothing; when evaluated on a WindowStream it
+    //  lets the window drop everything no live backtrack point still needs
+    [[nodiscard]]
+    inline Pattern
+    Commit() {
+        return __impl::MakePattern<__impl::CommitPattern>();
+    }
+}
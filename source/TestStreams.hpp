@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include <classy-streams/IOStreams.hpp>
+
+namespace test {
+    // seekable in-memory input
+    class StringStream :
+        public io::IStream {
+    public:
+        StringStream(std::string str) :
+            str(std::move(str)) {}
+
+        std::optional<std::byte>
+        Read() override {
+            if (this->iPos >= (intptr_t)this->str.size())
+                return std::nullopt;
+            return (std::byte)this->str[(size_t)this->iPos++];
+        }
+
+        intptr_t
+        GetPosition() override {
+            return this->iPos;
+        }
+
+        void
+        SetPosition(intptr_t iPosition) override {
+            this->iPos  = iPosition;
+        }
+
+    private:
+        std::string
+            str;
+        intptr_t
+            iPos    = 0;
+    };
+
+    // forward-only input, like a pipe: seeking anywhere but the current position throws
+    class PipeStream :
+        public io::IStream {
+    public:
+        PipeStream(std::string str) :
+            str(std::move(str)) {}
+
+        std::optional<std::byte>
+        Read() override {
+            if (this->iPos >= (intptr_t)this->str.size())
+                return std::nullopt;
+            return (std::byte)this->str[(size_t)this->iPos++];
+        }
+
+        intptr_t
+        GetPosition() override {
+            return this->iPos;
+        }
+
+        void
+        SetPosition(intptr_t iPosition) override {
+            if (iPosition != this->iPos)
+                throw std::logic_error("test::PipeStream: can't seek");
+        }
+
+    private:
+        std::string
+            str;
+        intptr_t
+            iPos    = 0;
+    };
+
+    // small deterministic generator, so failures reproduce everywhere
+    class Random {
+    public:
+        Random(uint64_t uSeed) :
+            uState(uSeed) {}
+
+        // uniform in [0, uBound)
+        size_t
+        Next(size_t uBound) {
+            this->uState    = this->uState * 6364136223846793005ull + 1442695040888963407ull;
+            return (size_t)((this->uState >> 33) % uBound);
+        }
+
+        std::string
+        String(std::string_view strvAlphabet, size_t uMaxLen) {
+            std::string
+                str;
+            size_t
+                uLen    = this->Next(uMaxLen + 1);
+            for (size_t i = 0; i != uLen; ++i)
+                str.push_back(strvAlphabet[this->Next(strvAlphabet.size())]);
+            return str;
+        }
+
+    private:
+        uint64_t
+            uState;
+    };
+
+    inline int
+        iFailures   = 0;
+
+    inline void
+    Check(bool bCondition, const char* lpszWhat, const std::string& strContext = {}) {
+        if (bCondition)
+            return;
+
+        iFailures   += 1;
+        if (iFailures <= 10)
+            std::fprintf(stderr, "FAILED: %s %s\n", lpszWhat, strContext.c_str());
+    }
+
+    inline int
+    Result() {
+        return (iFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,153 @@
+#include <string>
+#include <optional>
+
+#include <Patterns.hpp>
+
+#include "TestStreams.hpp"
+
+static bool
+Matches(const patt::Pattern& pattern, const std::string& strInput) {
+    test::StringStream
+        is(strInput);
+    patt::CaptureList
+        captures;
+    patt::OptMatch
+        optm    = patt::Eval(pattern, is, captures);
+    return optm && optm->End() == (intptr_t)strInput.size();
+}
+
+// character classes are built once on the heap, even when first asked for inside a scope
+static void
+TestSingletons() {
+    patt::PatternArena
+        arena;
+    {
+        auto
+            scope   = arena.Use();
+        patt::Pattern
+            arrClasses[]    = {
+                patt::Any(), patt::Alpha(), patt::Alnum(), patt::Digit(), patt::Blank() };
+        (void)arrClasses;
+        test::Check(arena.Live() == 0, "no singleton in the arena", std::to_string(arena.Live()));
+    }
+    test::Check(Matches(patt::Alpha() % 1, "abc"), "singletons usable after the arena's scope");
+}
+
+// Live() counts the nodes still referenced
+static void
+TestLive() {
+    patt::PatternArena
+        arena;
+    std::optional<patt::Pattern>
+        optPattern;
+    {
+        auto
+            scope   = arena.Use();
+        optPattern  = patt::Str("a") >> patt::Str("b");
+    }
+    test::Check(arena.Live() == 3, "concatenation and both operands", std::to_string(arena.Live()));
+
+    patt::Pattern
+        ptHeap  = patt::Str("c");
+    test::Check(arena.Live() == 3, "nodes outside a scope go to the heap", std::to_string(arena.Live()));
+
+    optPattern.reset();
+    test::Check(arena.Live() == 0, "released with the last handle", std::to_string(arena.Live()));
+}
+
+// an inner scope takes over until it ends, then the outer one is back
+static void
+TestNestedScopes() {
+    patt::PatternArena
+        outer,
+        inner;
+    patt::Pattern
+        ptOuter,
+        ptInner,
+        ptAfter,
+        ptHeap;
+    {
+        auto
+            scopeOuter  = outer.Use();
+        {
+            auto
+                scopeInner  = inner.Use();
+            ptInner = patt::Str("a");
+        }
+        ptAfter = patt::Str("b");
+        // the same arena twice
+        {
+            auto
+                scopeAgain  = outer.Use();
+            ptOuter = patt::Str("c");
+        }
+    }
+    ptHeap  = patt::Str("d");
+
+    test::Check(inner.Live() == 1, "inner scope", std::to_string(inner.Live()));
+    test::Check(outer.Live() == 2, "outer scope restored", std::to_string(outer.Live()));
+}
+
+// clones and inversions made in a scope live in the arena, and leave the shared original alone
+static void
+TestClone() {
+    patt::PatternArena
+        arena;
+    patt::Pattern
+        ptShared    = patt::Str("ab"),
+        ptKeep      = ptShared;
+    {
+        auto
+            scope   = arena.Use();
+        patt::Pattern
+            ptClone     = ptShared->Clone(),
+            ptInverted  = -ptShared,
+            ptAlpha     = -patt::Alpha();
+        test::Check(arena.Live() == 3, "clone and inversions in the arena", std::to_string(arena.Live()));
+        test::Check(Matches(ptClone, "ab") && Matches(ptShared, "ab"), "shared node not inverted");
+        test::Check(Matches(ptInverted >> patt::Str("x"), "x"), "inverted copy");
+        test::Check(Matches(ptAlpha >> patt::Str("1"), "1") && Matches(patt::Alpha(), "a"), "singleton not inverted");
+    }
+    test::Check(arena.Live() == 0, "released with the scope's handles", std::to_string(arena.Live()));
+}
+
+// handles may outlive their arena, the memory stays until the last one is gone
+static void
+TestOutlive() {
+    patt::Grammar
+        grammar;
+    patt::Pattern
+        pattern;
+    {
+        patt::PatternArena
+            arena;
+        auto
+            scope   = arena.Use();
+        grammar["list"] = patt::Str("(") >> (patt::Pattern(grammar["list"]) |= patt::Alpha()) % 0 >> patt::Str(")");
+        pattern = grammar["list"];
+    }
+    test::Check(Matches(pattern, "(a(bc)())"), "evaluated after the arena is gone");
+
+    // the last copy keeps the memory while another arena allocates
+    patt::Pattern
+        ptCopy  = pattern;
+    pattern.reset();
+    {
+        patt::PatternArena
+            arena;
+        auto
+            scope   = arena.Use();
+        patt::Pattern
+            ptOther = patt::Str("x") >> patt::Str("y");
+        test::Check(Matches(ptOther, "xy") && Matches(ptCopy, "()"), "arenas independent");
+    }
+}
+
+int main() {
+    TestSingletons();
+    TestLive();
+    TestNestedScopes();
+    TestClone();
+    TestOutlive();
+    return test::Result();
+}
@@ -0,0 +1,327 @@
+#include <string>
+#include <vector>
+
+#include <Patterns.hpp>
+#include <PatternSet.hpp>
+
+#include "TestStreams.hpp"
+
+namespace {
+    // handler that counts the matches it's called with; calls for failures before any
+    //  input is consumed are the ones a choice may skip
+    struct Counter {
+        std::vector<size_t>&
+            vecCounts;
+        size_t
+            uIndex;
+
+        void
+        operator()(io::IStream&, const patt::OptMatch& optm, const patt::CaptureList&, const std::any&) const {
+            if (optm)
+                this->vecCounts[this->uIndex] += 1;
+        }
+    };
+
+    // random grammar; with bWrap every choice alternative starts with a no-op handler
+    //  around an empty match, which keeps the choice from skipping any of them, as it
+    //  did before dispatch tables
+    class Generator {
+    public:
+        Generator(uint64_t uSeed, bool bWrap, std::vector<size_t>& vecCounts) :
+            rnd(uSeed), bWrap(bWrap), vecCounts(vecCounts) {}
+
+        patt::Pattern
+        Build(patt::Grammar& grammar) {
+            for (size_t i = 0; i != uRules; ++i)
+                grammar[name(i)]    = this->expression(grammar, i, 3);
+            return grammar[name(0)];
+        }
+
+    private:
+        static constexpr size_t
+            uRules  = 4;
+
+        static std::string
+        name(size_t i) {
+            std::string
+                strName = "r";
+            return strName += std::to_string(i);
+        }
+
+        patt::Pattern
+        alternative(patt::Grammar& grammar, size_t uRule, size_t uDepth) {
+            patt::Pattern
+                pattern = this->expression(grammar, uRule, uDepth);
+            if (this->bWrap)
+                pattern = (patt::Str("") / [](io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {}) >> pattern;
+            return pattern;
+        }
+
+        // rules reference later rules freely and earlier ones only after consuming input
+        patt::Pattern
+        expression(patt::Grammar& grammar, size_t uRule, size_t uDepth) {
+            size_t
+                uKind   = (uDepth == 0) ? this->rnd.Next(4) : this->rnd.Next(12);
+            switch (uKind) {
+            case 0:
+                return patt::Str(this->rnd.String("abc", 2));
+            case 1:
+                return patt::Set(this->rnd.String("abc()", 3));
+            case 2:
+                return patt::Any();
+            case 3:
+                return this->counted(patt::Str(this->rnd.String("abc", 1)));
+            case 4:
+                return patt::Capt(this->expression(grammar, uRule, uDepth - 1));
+            case 5: {
+                patt::Pattern
+                    lhs     = this->expression(grammar, uRule, uDepth - 1);
+                return lhs >> this->expression(grammar, uRule, uDepth - 1);
+            }
+            case 6:
+            case 7: {
+                patt::Pattern
+                    choice  = this->alternative(grammar, uRule, uDepth - 1);
+                size_t
+                    uMore   = 1 + this->rnd.Next(3);
+                for (size_t i = 0; i != uMore; ++i)
+                    choice  = (choice |= this->alternative(grammar, uRule, uDepth - 1));
+                return choice;
+            }
+            case 8:
+                // the body always consumes, so the repetition ends
+                return (patt::Any() >> this->expression(grammar, uRule, uDepth - 1)) % 0;
+            case 9:
+                return -this->expression(grammar, uRule, uDepth - 1);
+            case 10: {
+                size_t
+                    uTarget = this->rnd.Next(uRules);
+                if (uTarget > uRule)
+                    return grammar[name(uTarget)];
+                return patt::Str("(") >> patt::Pattern(grammar[name(uTarget)]);
+            }
+            default:
+                return this->counted(this->expression(grammar, uRule, uDepth - 1));
+            }
+        }
+
+        patt::Pattern
+        counted(patt::Pattern pattern) {
+            size_t
+                uIndex  = this->vecCounts.size();
+            this->vecCounts.push_back(0);
+            return pattern / Counter{ this->vecCounts, uIndex };
+        }
+
+        test::Random
+            rnd;
+        bool
+            bWrap;
+        std::vector<size_t>&
+            vecCounts;
+    };
+}
+
+// choices with dispatch tables behave like choices trying every alternative in order
+static void
+TestRandom() {
+    test::Random
+        rnd(11);
+    for (uint64_t uSeed = 0; uSeed != 5000; ++uSeed) {
+        std::vector<size_t>
+            vecCounts,
+            vecBaseCounts;
+        patt::Grammar
+            grammar,
+            baseGrammar;
+        patt::Pattern
+            pattern     = Generator(uSeed, false, vecCounts).Build(grammar),
+            basePattern = Generator(uSeed, true, vecBaseCounts).Build(baseGrammar);
+
+        for (size_t i = 0; i != 30; ++i) {
+            std::string
+                strInput    = rnd.String("abc()", 12),
+                strContext  = "seed ";
+            strContext  += std::to_string(uSeed);
+            strContext  += " input '";
+            strContext  += strInput;
+            strContext  += "'";
+            test::StringStream
+                is(strInput),
+                baseIs(strInput);
+            patt::CaptureList
+                captures,
+                baseCaptures;
+            patt::Failure
+                failure,
+                baseFailure;
+            patt::OptMatch
+                optm        = patt::Eval(pattern, is, captures, failure),
+                baseOptm    = patt::Eval(basePattern, baseIs, baseCaptures, baseFailure);
+
+            // captures are left over from failed alternatives when nothing matches
+            bool
+                bSame   = (bool)optm == (bool)baseOptm
+                    && (!optm || optm->End() == baseOptm->End())
+                    && is.GetPosition() == baseIs.GetPosition()
+                    && (!optm || captures.size() == baseCaptures.size());
+            for (size_t c = 0; bSame && optm && c != captures.size(); ++c)
+                bSame   = captures[c].Begin() == baseCaptures[c].Begin()
+                    && captures[c].End() == baseCaptures[c].End();
+            test::Check(bSame, "same match as trying every alternative", strContext);
+            test::Check(vecCounts == vecBaseCounts, "same handler calls", strContext);
+            test::Check(failure.iPosition == baseFailure.iPosition, "same farthest failure", strContext);
+        }
+    }
+}
+
+// redefining a rule rebuilds the tables of choices looking through it
+static void
+TestRedefine() {
+    patt::Grammar
+        grammar;
+    grammar["kw"]   = patt::Str("if");
+    patt::Pattern
+        ptStmt  = patt::Pattern(grammar["kw"]) |= patt::Str("x");
+    patt::CaptureList
+        captures;
+
+    test::StringStream
+        isIf("if");
+    test::Check((bool)patt::Eval(ptStmt, isIf, captures), "matches the first definition");
+
+    grammar["kw"]   = patt::Str("while");
+    test::StringStream
+        isWhile("while");
+    test::Check((bool)patt::Eval(ptStmt, isWhile, captures), "matches the new definition");
+    test::StringStream
+        isOld("if");
+    test::Check(!patt::Eval(ptStmt, isOld, captures), "no longer matches the old definition");
+
+    // a handler added by a redefinition is called, too
+    size_t
+        uCalls  = 0;
+    patt::Pattern
+        ptCounted   = -patt::Str("if") / [&](io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {
+            uCalls  += 1;
+        };
+    grammar["kw"]   = ptCounted >> patt::Str("while");
+    test::StringStream
+        isX("x");
+    test::Check((bool)patt::Eval(ptStmt, isX, captures), "second alternative");
+    test::Check(uCalls == 1, "handler of a redefined rule called", std::to_string(uCalls));
+}
+
+// a pattern set rebuilds its tables after a redefinition, too
+static void
+TestSetRedefine() {
+    patt::Grammar
+        grammar;
+    grammar["kw"]   = patt::Str("if");
+    patt::PatternSet
+        set;
+    set.Add(grammar["kw"]);
+
+    test::StringStream
+        isIf("if");
+    test::Check(set.Eval(isIf).size() == 1, "set matches the first definition");
+
+    grammar["kw"]   = patt::Str("while");
+    test::StringStream
+        isWhile("while");
+    test::Check(set.Eval(isWhile).size() == 1, "set matches the new definition");
+
+    // the copy builds its own tables
+    patt::PatternSet
+        copy    = set;
+    copy.Add(patt::Str("x"));
+    test::StringStream
+        isX("x");
+    test::Check(copy.Eval(isX).size() == 1 && set.Eval(isX).empty(), "copies are independent");
+}
+
+// redefining a rule from a handler leaves the running evaluation's table alone
+static void
+TestRedefineDuringEval() {
+    patt::Grammar
+        grammar;
+    grammar["kw"]   = patt::Str("a");
+    patt::Pattern
+        ptRedefine  = patt::Str("") / [&](io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {
+            grammar["kw"]   = patt::Str("b");
+        },
+        pattern     = (ptRedefine >> patt::Pattern(grammar["kw"])) |= patt::Str("c");
+    patt::CaptureList
+        captures;
+
+    test::StringStream
+        is("b");
+    test::Check((bool)patt::Eval(pattern, is, captures), "rule redefined before it's evaluated");
+    test::StringStream
+        isC("c");
+    test::Check((bool)patt::Eval(pattern, isC, captures), "second alternative after the redefinition");
+}
+
+// an alternative that can't match still calls its handlers
+static void
+TestHandlers() {
+    size_t
+        uCalls  = 0;
+    patt::Pattern
+        ptCounted   = -patt::Str("a") / [&](io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {
+            uCalls  += 1;
+        },
+        pattern     = (ptCounted >> patt::Str("b")) |= patt::Str("c");
+    patt::CaptureList
+        captures;
+
+    test::StringStream
+        is("c");
+    test::Check((bool)patt::Eval(pattern, is, captures), "second alternative");
+    test::Check(uCalls == 1, "handler in the first alternative called", std::to_string(uCalls));
+
+    // also behind something that matches empty
+    patt::Pattern
+        ptBehind    = (patt::Str("") >> ptCounted >> patt::Str("b")) |= patt::Str("c");
+    test::StringStream
+        isBehind("c");
+    test::Check((bool)patt::Eval(ptBehind, isBehind, captures), "second alternative");
+    test::Check(uCalls == 2, "handler behind an empty match called", std::to_string(uCalls));
+}
+
+// a handler around a rule that has to consume doesn't keep the choice from skipping it
+static void
+TestRuleHandlers() {
+    size_t
+        uCalls  = 0;
+    patt::Grammar
+        grammar;
+    grammar["num"]  = patt::Capt(patt::Digit() % 1) / [&](io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {
+        uCalls  += 1;
+    };
+    patt::Pattern
+        pattern     = patt::Pattern(grammar["num"]) |= patt::Str("x");
+    patt::CaptureList
+        captures;
+
+    test::StringStream
+        isX("x");
+    test::Check((bool)patt::Eval(pattern, isX, captures), "second alternative");
+    test::Check(uCalls == 0, "rule skipped", std::to_string(uCalls));
+
+    test::StringStream
+        isNum("42");
+    test::Check((bool)patt::Eval(pattern, isNum, captures), "first alternative");
+    test::Check(uCalls == 1, "rule handler called", std::to_string(uCalls));
+}
+
+int
+main() {
+    TestRandom();
+    TestRedefine();
+    TestSetRedefine();
+    TestRedefineDuringEval();
+    TestHandlers();
+    TestRuleHandlers();
+    return test::Result();
+}
@@ -0,0 +1,147 @@
+#include <string>
+
+#include <Patterns.hpp>
+#include <Incremental.hpp>
+
+#include "TestStreams.hpp"
+
+// statements with nested lists, captures and whitespace around everything
+static patt::Pattern
+MakeDocument(patt::Grammar& grammar) {
+    patt::Pattern
+        ptID    = patt::Capt(patt::Alpha() % 1);
+    grammar["ws"]   = patt::Set(" \n") % 0;
+    grammar["val"]  = ptID
+        |= patt::Capt(patt::Digit() % 1)
+        |= patt::Str("(") >> patt::Pattern(grammar["list"]) >> patt::Str(")");
+    grammar["list"] = patt::Pattern(grammar["ws"]) >> (patt::Pattern(grammar["val"]) >> patt::Pattern(grammar["ws"])) % 0;
+    grammar["stmt"] = patt::Pattern(grammar["ws"]) >> ptID >> patt::Pattern(grammar["ws"])
+        >> patt::Str("=") >> patt::Pattern(grammar["ws"]) >> patt::Pattern(grammar["val"])
+        >> patt::Pattern(grammar["ws"]) >> patt::Str(";");
+    grammar["doc"]  = patt::Pattern(grammar["stmt"]) % 0 >> patt::Pattern(grammar["ws"]) >> -patt::Any();
+    return grammar["doc"];
+}
+
+// after every random edit, the incremental parse equals a full parse of the edited text
+static void
+TestRandomEdits() {
+    patt::Grammar
+        grammar;
+    patt::Pattern
+        ptDoc   = MakeDocument(grammar);
+    test::Random
+        rnd(5);
+
+    for (size_t t = 0; t != 300; ++t) {
+        std::string
+            strDoc;
+        for (size_t i = 0; i != 50; ++i) {
+            strDoc  += "a";
+            strDoc  += std::to_string(i);
+            strDoc  += " = ";
+            strDoc  += (rnd.Next(3) == 0) ? "(x 1 (y 2))" : std::to_string(rnd.Next(100));
+            strDoc  += ";\n";
+        }
+
+        patt::IncrementalParser
+            parser(ptDoc);
+        for (size_t e = 0; e != 20; ++e) {
+            test::StringStream
+                isIncremental(strDoc),
+                isFull(strDoc);
+            patt::CaptureList
+                capturesIncremental,
+                capturesFull;
+            patt::OptMatch
+                optIncremental  = parser.Parse(isIncremental, capturesIncremental),
+                optFull         = patt::Eval(ptDoc, isFull, capturesFull);
+
+            std::string
+                strContext  = "document ";
+            strContext  += std::to_string(t);
+            strContext  += " edit ";
+            strContext  += std::to_string(e);
+            test::Check(optIncremental.has_value() == optFull.has_value(), "result", strContext);
+            if (optIncremental && optFull)
+                test::Check(optIncremental->End() == optFull->End(), "match end", strContext);
+            test::Check(isIncremental.GetPosition() == isFull.GetPosition(), "position", strContext);
+
+            bool
+                bSame   = capturesIncremental.size() == capturesFull.size();
+            for (size_t i = 0; bSame && i != capturesFull.size(); ++i) {
+                bSame   = capturesIncremental[i].Begin() == capturesFull[i].Begin()
+                    && capturesIncremental[i].End() == capturesFull[i].End();
+            }
+            test::Check(bSame, "captures", strContext);
+
+            size_t
+                uOffset     = rnd.Next(strDoc.size() + 1),
+                uRemoved    = std::min(rnd.Next(4), strDoc.size() - uOffset);
+            std::string
+                strInserted = rnd.String(" ;=(a1)\nxz9", 3);
+            strDoc.replace(uOffset, uRemoved, strInserted);
+            parser.Edit((intptr_t)uOffset, uRemoved, strInserted.size());
+        }
+    }
+}
+
+// work after a one-byte edit doesn't depend on the document size
+static void
+TestEditCost() {
+    patt::Grammar
+        grammar;
+    patt::Pattern
+        ptDoc   = MakeDocument(grammar);
+
+    size_t
+        arrWork[2]  = {};
+    size_t
+        arrStatements[2]    = { 2000, 20000 };
+    for (size_t k = 0; k != 2; ++k) {
+        std::string
+            strDoc;
+        for (size_t i = 0; i != arrStatements[k]; ++i) {
+            strDoc  += "k = ";
+            strDoc  += std::to_string(i % 1000);
+            strDoc  += ";\n";
+        }
+
+        patt::IncrementalParser
+            parser(ptDoc);
+        patt::CaptureList
+            captures;
+        test::StringStream
+            isFirst(strDoc);
+        (void)parser.Parse(isFirst, captures);
+
+        // a digit in the middle of the document
+        size_t
+            uOffset = strDoc.size() / 2;
+        while (strDoc[uOffset] < '0' || strDoc[uOffset] > '9')
+            uOffset += 1;
+        strDoc[uOffset] = (strDoc[uOffset] == '7') ? '8' : '7';
+        parser.Edit((intptr_t)uOffset, 1, 1);
+
+        captures.clear();
+        test::StringStream
+            isSecond(strDoc);
+        patt::OptMatch
+            optm    = parser.Parse(isSecond, captures);
+        test::Check(optm && optm->End() == (intptr_t)strDoc.size(), "edited document parsed");
+        test::Check(captures.size() == 2 * arrStatements[k], "captures of the edited document");
+        arrWork[k]  = parser.Evaluated() + parser.Reused();
+    }
+
+    std::string
+        strWork = std::to_string(arrWork[0]);
+    strWork += " vs ";
+    strWork += std::to_string(arrWork[1]);
+    test::Check(arrWork[0] == arrWork[1], "reparse work independent of the document size", strWork);
+    test::Check(arrWork[0] < 50, "reparse work bounded", std::to_string(arrWork[0]));
+}
+
+int main() {
+    TestRandomEdits();
+    TestEditCost();
+    return test::Result();
+}
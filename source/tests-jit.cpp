@@ -0,0 +1,122 @@
+#include <string>
+#include <string_view>
+
+#include <Patterns.hpp>
+#include <PatternJit.hpp>
+
+#include "TestStreams.hpp"
+
+// random patterns over a small alphabet, made of the nodes the JIT compiles
+static patt::Pattern
+GenPattern(test::Random& rnd, int iDepth) {
+    switch ((iDepth <= 0) ? rnd.Next(4) : rnd.Next(11)) {
+    case 0:     return patt::Str(rnd.String("abc\n", 3));
+    case 1:     return patt::Set(rnd.String("abc\n", 3) + "a");
+    case 2:     return patt::Any();
+    case 3:     return patt::Alpha();
+    case 4:     return GenPattern(rnd, iDepth - 1) >> GenPattern(rnd, iDepth - 1);
+    case 5:     return GenPattern(rnd, iDepth - 1) |= GenPattern(rnd, iDepth - 1);
+    case 6:     return GenPattern(rnd, iDepth - 1) % ((ssize_t)rnd.Next(7) - 3);
+    case 7:     return GenPattern(rnd, iDepth - 1) * rnd.Next(6);
+    case 8:     return &GenPattern(rnd, iDepth - 1);
+    case 9:     return -GenPattern(rnd, iDepth - 1);
+    default:    return GenPattern(rnd, iDepth - 1) >> GenPattern(rnd, iDepth - 1);
+    }
+}
+
+// the native matcher agrees with the interpreter on results and stream positions
+static void
+TestRandom() {
+    test::Random
+        rnd(12345);
+    size_t
+        uNative = 0;
+    for (size_t t = 0; t != 4000; ++t) {
+        patt::Pattern
+            pattern = GenPattern(rnd, 4);
+        patt::JitPattern
+            jit(pattern);
+        // repeats of patterns that may match nothing aren't compiled, and loop forever interpreted
+        if (!jit.IsNative())
+            continue;
+        uNative += 1;
+
+        for (size_t k = 0; k != 20; ++k) {
+            // a few long inputs, so the buffer has to grow many times
+            std::string
+                strInput    = rnd.String("abc\n", (rnd.Next(50) == 0) ? 3000 : 12);
+            test::StringStream
+                isInterp(strInput),
+                isJit(strInput);
+            patt::CaptureList
+                capturesInterp,
+                capturesJit;
+            patt::OptMatch
+                optInterp   = patt::Eval(pattern, isInterp, capturesInterp),
+                optJit      = jit.Eval(isJit, capturesJit),
+                optView     = jit.Eval(std::string_view(strInput));
+
+            std::string
+                strContext  = "pattern " + std::to_string(t) + " input \"" + strInput + "\"";
+            test::Check(optInterp.has_value() == optJit.has_value(), "stream result", strContext);
+            test::Check(optInterp.has_value() == optView.has_value(), "view result", strContext);
+            if (optInterp && optJit && optView) {
+                test::Check(optInterp->Begin() == optJit->Begin(), "stream match begin", strContext);
+                test::Check(optInterp->End() == optJit->End(), "stream match end", strContext);
+                test::Check(optInterp->End() == optView->End(), "view match end", strContext);
+                test::Check(isInterp.GetPosition() == isJit.GetPosition(), "stream position", strContext);
+            }
+        }
+    }
+
+#if PATT_JIT_NATIVE
+    test::Check(uNative > 1000, "most random patterns compile natively");
+#else
+    (void)uNative;
+#endif
+}
+
+// input the native code runs out of is read in growing steps, never ahead of need
+static void
+TestUnderflow() {
+    std::string
+        strLong(1000, 'a');
+    patt::JitPattern
+        jit(patt::Str(strLong) >> patt::Str("b"));
+    test::StringStream
+        is(strLong + "b" + "tail");
+    patt::CaptureList
+        captures;
+    patt::OptMatch
+        optm    = jit.Eval(is, captures);
+    test::Check(optm && optm->End() == 1001, "long literal over a growing buffer");
+    test::Check(is.GetPosition() == 1001, "position after a long literal");
+
+    // one byte is all a single-byte pattern may read from a pipe
+    patt::JitPattern
+        jitByte(patt::Set("xy"));
+    test::PipeStream
+        isPipe("x");
+    test::Check(jitByte.Eval(isPipe, captures).has_value(), "single byte from a pipe");
+    test::Check(isPipe.GetPosition() == 1, "single byte read exactly");
+}
+
+// patterns the JIT can't compile run through the interpreter, in-memory input included
+static void
+TestFallback() {
+    patt::JitPattern
+        jit(patt::Capt(patt::Str("ab")) >> patt::Str("c"));
+    test::Check(!jit.IsNative(), "captures are not compiled");
+
+    patt::OptMatch
+        optm    = jit.Eval(std::string_view("abcd"));
+    test::Check(optm && optm->End() == 3, "view fallback matches");
+    test::Check(!jit.Eval(std::string_view("abd")), "view fallback fails");
+}
+
+int main() {
+    TestRandom();
+    TestUnderflow();
+    TestFallback();
+    return test::Result();
+}
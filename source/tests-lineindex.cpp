@@ -0,0 +1,232 @@
+#include <string>
+#include <stdexcept>
+
+#include <Patterns.hpp>
+#include <LineIndex.hpp>
+
+#include "TestStreams.hpp"
+
+// line:column of an offset, counted byte by byte
+static patt::TextPosition
+NaiveLocate(const std::string& strText, size_t uOffset) {
+    patt::TextPosition
+        position{ 1, 1 };
+    for (size_t i = 0; i != uOffset; ++i) {
+        if (strText[i] == '\n')
+            position    = patt::TextPosition{ position.uLine + 1, 1 };
+        else
+            position.uColumn    += 1;
+    }
+    return position;
+}
+
+static bool
+SamePosition(const patt::TextPosition& lhs, const patt::TextPosition& rhs) {
+    return lhs.uLine == rhs.uLine && lhs.uColumn == rhs.uColumn;
+}
+
+// every offset of the text, the end included, maps to the naive line:column
+static void
+CheckAll(patt::LineIndex& index, const std::string& strText, const char* lpszWhat) {
+    for (size_t i = 0; i <= strText.size(); ++i) {
+        std::string
+            strContext  = "offset ";
+        strContext  += std::to_string(i);
+        strContext  += " of '";
+        strContext  += strText;
+        strContext  += "'";
+        test::Check(SamePosition(index.Locate((intptr_t)i), NaiveLocate(strText, i)), lpszWhat, strContext);
+    }
+}
+
+// texts appended at once, in random pieces and byte by byte index the same; long pieces
+//  go through the 16-byte chunks, short ones and the rest of long ones through memchr
+static void
+TestAppend() {
+    test::Random
+        rnd(3);
+    for (size_t t = 0; t != 2000; ++t) {
+        std::string
+            strText = rnd.String((t % 2 == 0) ? "ab\n" : "abcdefg\n", (t % 10 == 0) ? 200 : 40);
+        if (t % 50 == 0)
+            strText = std::string(64, '\n');
+
+        patt::LineIndex
+            whole,
+            pieces,
+            bytes;
+        whole.Append(strText);
+        for (size_t i = 0; i != strText.size(); ) {
+            size_t
+                uPiece  = std::min(1 + rnd.Next(40), strText.size() - i);
+            pieces.Append(std::string_view(strText).substr(i, uPiece));
+            i   += uPiece;
+        }
+        for (char c : strText)
+            bytes.Append((std::byte)c);
+
+        test::Check(whole.Indexed() == (intptr_t)strText.size(), "whole text indexed");
+        CheckAll(whole, strText, "appended at once");
+        CheckAll(pieces, strText, "appended in pieces");
+        CheckAll(bytes, strText, "appended byte by byte");
+    }
+
+    // newlines on both sides of every chunk boundary
+    std::string
+        strEdges(48, 'x');
+    for (size_t i : { 0, 14, 15, 16, 17, 31, 32, 47 })
+        strEdges[i] = '\n';
+    patt::LineIndex
+        edges;
+    edges.Append(strEdges);
+    CheckAll(edges, strEdges, "newlines at chunk boundaries");
+}
+
+// an index over an in-memory text only scans as far as the queries need
+static void
+TestLazy() {
+    test::Random
+        rnd(4);
+    std::string
+        strText = rnd.String("abc\n", 10000);
+    while (strText.size() < 5000)
+        strText += rnd.String("abc\n", 10000);
+
+    patt::LineIndex
+        index(strText);
+    test::Check(index.Indexed() == 0, "nothing indexed up front");
+    test::Check(SamePosition(index.Locate(10), NaiveLocate(strText, 10)), "early offset");
+    test::Check(index.Indexed() > 10 && index.Indexed() < (intptr_t)strText.size(), "early offset scans a prefix",
+        std::to_string(index.Indexed()));
+
+    for (size_t i = 0; i != 300; ++i) {
+        size_t
+            uOffset = rnd.Next(strText.size() + 1);
+        test::Check(SamePosition(index.Locate((intptr_t)uOffset), NaiveLocate(strText, uOffset)), "random offset",
+            std::to_string(uOffset));
+    }
+    test::Check(SamePosition(index.Locate((intptr_t)strText.size()), NaiveLocate(strText, strText.size())), "end of text");
+    test::Check(index.Indexed() == (intptr_t)strText.size(), "whole text indexed at the end");
+
+    // offsets past the text stay on its last line
+    patt::LineIndex
+        past("a\nb");
+    test::Check(SamePosition(past.Locate(5), patt::TextPosition{ 2, 4 }), "offset past the text");
+}
+
+// fed while matching, backtracking included, the index equals one built from the whole input
+static void
+TestIndexingStream() {
+    patt::Pattern
+        ptLine  = patt::Str("ab\n")
+            |= patt::Capt(patt::Set("ab") % 1) >> patt::Str("\n"),
+        ptDoc   = ptLine % 0 >> -patt::Any();
+    test::Random
+        rnd(5);
+    for (size_t t = 0; t != 500; ++t) {
+        std::string
+            strText;
+        size_t
+            uLines  = rnd.Next(20);
+        for (size_t i = 0; i != uLines; ++i) {
+            strText += "ab";
+            if (rnd.Next(2) == 0)
+                strText += rnd.String("ab", 30);
+            strText += "\n";
+        }
+
+        test::StringStream
+            source(strText);
+        patt::LineIndex
+            index;
+        patt::IndexingStream
+            is(source, index);
+        patt::CaptureList
+            captures;
+        patt::OptMatch
+            optm    = patt::Eval(ptDoc, is, captures);
+
+        std::string
+            strContext  = "text '";
+        strContext  += strText;
+        strContext  += "'";
+        test::Check(optm && optm->End() == (intptr_t)strText.size(), "document matched", strContext);
+        test::Check(index.Indexed() == (intptr_t)strText.size(), "every byte indexed once", strContext);
+        CheckAll(index, strText, "indexed while matching");
+        for (const auto& capture : captures) {
+            auto
+                range   = index.Locate(capture);
+            test::Check(SamePosition(range.first, NaiveLocate(strText, (size_t)capture.Begin()))
+                && SamePosition(range.second, NaiveLocate(strText, (size_t)capture.End())), "capture located", strContext);
+        }
+    }
+}
+
+// the farthest failure locates the error, also where a choice skipped alternatives
+static void
+TestFailure() {
+    patt::Pattern
+        ptKeyword   = patt::Str("let") |= patt::Str("var") |= patt::Str("const"),
+        ptStmt      = ptKeyword >> patt::Str(" ") >> patt::Alpha() % 1 >> patt::Str(";\n"),
+        ptDoc       = ptStmt % 0 >> -patt::Any();
+
+    struct Case {
+        const char*
+            lpszText;
+        patt::TextPosition
+            position;
+    };
+    const Case
+        arrCases[]  = {
+            // the first keyword matches and the statement stops at the digit
+            { "let a;\nlet b1;\n",  { 2, 6 } },
+            // "var" reads further than the other alternatives
+            { "let a;\nvat b;\n",   { 2, 3 } },
+            // every alternative is skipped on the first byte
+            { "let a;\nx b;\n",     { 2, 1 } },
+            // "const" is the last alternative and the only one tried
+            { "const a;\nconst",    { 2, 6 } },
+        };
+    for (const Case& c : arrCases) {
+        test::StringStream
+            is(c.lpszText);
+        patt::CaptureList
+            captures;
+        patt::Failure
+            failure;
+        test::Check(!patt::Eval(ptDoc, is, captures, failure), "invalid document", c.lpszText);
+
+        patt::LineIndex
+            index(c.lpszText);
+        std::optional<patt::TextPosition>
+            optPosition = index.Locate(failure);
+        std::string
+            strContext  = c.lpszText;
+        strContext  += " at ";
+        strContext  += std::to_string(failure.iPosition);
+        test::Check(optPosition && SamePosition(*optPosition, c.position), "failure located", strContext);
+    }
+
+    // nothing failed, nothing to locate
+    patt::LineIndex
+        index("let a;\n");
+    test::Check(!index.Locate(patt::Failure{}), "no failure, no position");
+
+    bool
+        bThrown = false;
+    try {
+        (void)index.Locate(-1);
+    }
+    catch (const std::out_of_range&) {
+        bThrown = true;
+    }
+    test::Check(bThrown, "negative offset rejected");
+}
+
+int main() {
+    TestAppend();
+    TestLazy();
+    TestIndexingStream();
+    TestFailure();
+    return test::Result();
+}
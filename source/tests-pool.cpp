@@ -0,0 +1,163 @@
+#include <string>
+
+#include <Patterns.hpp>
+
+#include "TestStreams.hpp"
+
+static void
+Noop(io::IStream&, const patt::OptMatch&, const patt::CaptureList&, const std::any&) {}
+
+static bool
+Matches(const patt::Pattern& pattern, const std::string& strInput) {
+    test::StringStream
+        is(strInput);
+    patt::CaptureList
+        captures;
+    patt::OptMatch
+        optm    = patt::Eval(pattern, is, captures);
+    return optm && optm->End() == (intptr_t)strInput.size();
+}
+
+// identical subtrees become one node, the pool and Stats count each once
+static void
+TestMerge() {
+    patt::Pattern
+        pattern = (patt::Str("ab") >> patt::Set("xy")) |= (patt::Str("ab") >> patt::Set("xy"));
+    patt::PatternStats
+        before  = patt::Stats(pattern);
+    test::Check(before.uNodes == 7, "distinct nodes before interning", std::to_string(before.uNodes));
+
+    patt::PatternPool
+        pool;
+    patt::Pattern
+        interned    = pool.Intern(pattern);
+    patt::PatternStats
+        after   = patt::Stats(interned);
+    test::Check(after.uNodes == 4, "distinct nodes after interning", std::to_string(after.uNodes));
+    test::Check(after.uBytes < before.uBytes, "fewer bytes after interning");
+    test::Check(pool.Size() == 4 && pool.Stats().uNodes == 4, "pool holds each node once", std::to_string(pool.Size()));
+    test::Check(Matches(interned, "abx") && !Matches(interned, "aby!"), "interned pattern matches the same");
+
+    // interning again, or an equal pattern built separately, adds nothing
+    patt::Pattern
+        again   = pool.Intern(patt::Str("ab") >> patt::Set("xy"));
+    test::Check(pool.Size() == 4, "nothing new to intern", std::to_string(pool.Size()));
+    test::Check(pool.Intern(interned) == interned, "interned pattern maps to itself");
+    test::Check(pool.Stats().uBytes == after.uBytes, "pool bytes match the pattern's");
+    (void)again;
+}
+
+// handler nodes stay apart even around the same callback, their operands are still shared
+static void
+TestHandlers() {
+    patt::Pattern
+        pattern = (patt::Str("a") / Noop) |= (patt::Str("a") / Noop);
+    patt::PatternPool
+        pool;
+    patt::PatternStats
+        stats   = patt::Stats(pool.Intern(pattern));
+    test::Check(stats.uNodes == 4, "choice, two handlers and one operand", std::to_string(stats.uNodes));
+
+    // the same handler node reached twice is still one node
+    patt::Pattern
+        ptHandler   = patt::Str("b") / Noop;
+    stats   = patt::Stats(pool.Intern(ptHandler >> ptHandler));
+    test::Check(stats.uNodes == 3, "one handler reached twice", std::to_string(stats.uNodes));
+}
+
+// a grammar with repeated subtrees evaluates the same after interning, with fewer nodes
+static void
+TestGrammar() {
+    patt::Grammar
+        grammar,
+        interned;
+    for (patt::Grammar* lpGrammar : { &grammar, &interned }) {
+        patt::Grammar&
+            g       = *lpGrammar;
+        g["ws"]     = patt::Set(" \n") % 0;
+        g["num"]    = patt::Capt(patt::Digit() % 1) >> patt::Pattern(g["ws"]);
+        g["id"]     = patt::Capt(patt::Alpha() % 1) >> patt::Set(" \n") % 0;
+        g["list"]   = patt::Str("[") >> patt::Set(" \n") % 0
+            >> (patt::Pattern(g["value"]) >> (patt::Str(",") >> patt::Set(" \n") % 0 >> patt::Pattern(g["value"])) % 0) * 1
+            >> patt::Str("]") >> patt::Set(" \n") % 0;
+        g["value"]  = patt::Pattern(g["num"]) |= patt::Pattern(g["id"]) |= patt::Pattern(g["list"]);
+    }
+
+    patt::PatternStats
+        before  = patt::Stats(interned);
+    patt::PatternPool
+        pool;
+    pool.Intern(interned);
+    patt::PatternStats
+        after   = patt::Stats(interned);
+    std::string
+        strNodes    = std::to_string(before.uNodes);
+    strNodes    += " vs ";
+    strNodes    += std::to_string(after.uNodes);
+    test::Check(after.uNodes < before.uNodes, "fewer nodes after interning", strNodes);
+
+    test::Random
+        rnd(7);
+    for (size_t i = 0; i != 3000; ++i) {
+        std::string
+            strInput    = rnd.String("[],1a ", 16);
+        test::StringStream
+            is(strInput),
+            isInterned(strInput);
+        patt::CaptureList
+            captures,
+            capturesInterned;
+        patt::OptMatch
+            optm            = patt::Eval(grammar["value"], is, captures),
+            optmInterned    = patt::Eval(interned["value"], isInterned, capturesInterned);
+
+        bool
+            bSame   = (bool)optm == (bool)optmInterned
+                && (!optm || optm->End() == optmInterned->End())
+                && is.GetPosition() == isInterned.GetPosition()
+                && (!optm || captures.size() == capturesInterned.size());
+        for (size_t c = 0; bSame && optm && c != captures.size(); ++c)
+            bSame   = captures[c].Begin() == capturesInterned[c].Begin()
+                && captures[c].End() == capturesInterned[c].End();
+        test::Check(bSame, "same result after interning", strInput);
+    }
+}
+
+// inverting a shared node inverts a private copy
+static void
+TestInvert() {
+    patt::PatternPool
+        pool;
+    patt::Pattern
+        interned    = pool.Intern(patt::Str("ab") >> patt::Str("ab"));
+    patt::Pattern
+        ptShared    = pool.Intern(patt::Str("ab"));
+
+    patt::Pattern
+        ptInverted  = -ptShared,
+        ptMoved     = -patt::Pattern(ptShared);
+    test::Check(ptInverted != ptShared && ptMoved != ptShared, "inversions are copies");
+    test::Check(Matches(interned, "abab"), "pattern using the shared node unchanged");
+    test::Check(Matches(ptInverted >> patt::Str("x"), "x") && Matches(ptMoved >> patt::Str("x"), "x"), "copies inverted");
+
+    patt::Pattern
+        ptNotAlpha  = -patt::Alpha();
+    test::Check(Matches(patt::Alpha(), "a") && !Matches(patt::Alpha(), "1"), "Alpha() unchanged");
+    test::Check(Matches(ptNotAlpha >> patt::Any(), "1"), "inverted Alpha() copy");
+
+    // a node nobody else holds is inverted in place
+    patt::Pattern
+        ptOwn       = patt::Str("c");
+    const void*
+        lpOwn       = ptOwn.get();
+    ptOwn   = -std::move(ptOwn);
+    test::Check(ptOwn.get() == lpOwn, "unshared node inverted in place");
+}
+
+int main() {
+    TestMerge();
+    TestHandlers();
+    TestGrammar();
+    TestInvert();
+    return test::Result();
+}
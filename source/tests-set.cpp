@@ -0,0 +1,211 @@
+#include <string>
+#include <vector>
+
+#include <Patterns.hpp>
+#include <PatternSet.hpp>
+
+#include "TestStreams.hpp"
+
+namespace {
+    // handler that counts the matches it's called with
+    struct Counter {
+        std::vector<size_t>&
+            vecCounts;
+        size_t
+            uIndex;
+
+        void
+        operator()(io::IStream&, const patt::OptMatch& optm, const patt::CaptureList&, const std::any&) const {
+            if (optm)
+                this->vecCounts[this->uIndex] += 1;
+        }
+    };
+
+    // counts the bytes read through it
+    class CountingStream :
+        public io::IStream {
+    public:
+        CountingStream(io::IStream& source) :
+            source(source) {}
+
+        std::optional<std::byte>
+        Read() override {
+            this->uReads    += 1;
+            return this->source.Read();
+        }
+
+        intptr_t
+        GetPosition() override {
+            return this->source.GetPosition();
+        }
+
+        void
+        SetPosition(intptr_t iPosition) override {
+            this->source.SetPosition(iPosition);
+        }
+
+        size_t
+            uReads  = 0;
+
+    private:
+        io::IStream&
+            source;
+    };
+}
+
+// random patterns over a small alphabet: literals, captures, end of input and handlers
+static patt::Pattern
+GenPattern(test::Random& rnd, int iDepth, std::vector<size_t>& vecCounts) {
+    switch ((iDepth <= 0) ? rnd.Next(5) : rnd.Next(12)) {
+    case 0:     return patt::Str(rnd.String("abc", 3));
+    case 1:     return patt::Set(rnd.String("abc", 2));
+    case 2:     return patt::Any();
+    case 3:     return patt::None();
+    case 4: {
+        size_t
+            uIndex  = vecCounts.size();
+        vecCounts.push_back(0);
+        return patt::Str(rnd.String("abc", 1)) / Counter{ vecCounts, uIndex };
+    }
+    case 5:     return patt::Capt(GenPattern(rnd, iDepth - 1, vecCounts));
+    case 6:     return GenPattern(rnd, iDepth - 1, vecCounts) |= GenPattern(rnd, iDepth - 1, vecCounts);
+    case 7:     return (patt::Any() >> GenPattern(rnd, iDepth - 1, vecCounts)) % 0;
+    case 8:     return GenPattern(rnd, iDepth - 1, vecCounts) * rnd.Next(3);
+    case 9:     return -GenPattern(rnd, iDepth - 1, vecCounts);
+    case 10:    return &GenPattern(rnd, iDepth - 1, vecCounts);
+    default:    return GenPattern(rnd, iDepth - 1, vecCounts) >> GenPattern(rnd, iDepth - 1, vecCounts);
+    }
+}
+
+// a set reports what evaluating each of its patterns on its own reports, handlers included
+static void
+TestRandom() {
+    test::Random
+        rnd(21);
+    for (size_t t = 0; t != 2000; ++t) {
+        std::vector<size_t>
+            vecCounts;
+        std::vector<patt::Pattern>
+            vecPatterns;
+        patt::PatternSet
+            set;
+        size_t
+            uPatterns   = 1 + rnd.Next(8);
+        for (size_t i = 0; i != uPatterns; ++i) {
+            vecPatterns.push_back(GenPattern(rnd, 3, vecCounts));
+            test::Check(set.Add(vecPatterns.back()) == i, "index of an added pattern");
+        }
+
+        for (size_t k = 0; k != 20; ++k) {
+            std::string
+                strInput    = rnd.String("abc", 8);
+            intptr_t
+                iStart      = (intptr_t)rnd.Next(strInput.size() + 1);
+            std::string
+                strContext  = "set ";
+            strContext  += std::to_string(t);
+            strContext  += " input '";
+            strContext  += strInput;
+            strContext  += "' at ";
+            strContext  += std::to_string(iStart);
+
+            std::vector<size_t>
+                vecExpectedCounts   = vecCounts;
+            patt::SetMatchList
+                expected;
+            for (size_t i = 0; i != vecPatterns.size(); ++i) {
+                test::StringStream
+                    is(strInput);
+                is.SetPosition(iStart);
+                patt::CaptureList
+                    captures;
+                patt::OptMatch
+                    optm    = patt::Eval(vecPatterns[i], is, captures);
+                if (optm)
+                    expected.push_back(patt::SetMatch{ i, *optm, std::move(captures) });
+            }
+            std::swap(vecExpectedCounts, vecCounts);
+
+            test::StringStream
+                is(strInput);
+            is.SetPosition(iStart);
+            patt::SetMatchList
+                matches = set.Eval(is);
+            test::Check(is.GetPosition() == iStart, "position left unchanged", strContext);
+            test::Check(vecCounts == vecExpectedCounts, "same handler calls", strContext);
+
+            bool
+                bSame   = matches.size() == expected.size();
+            for (size_t m = 0; bSame && m != matches.size(); ++m) {
+                bSame   = matches[m].uIndex == expected[m].uIndex
+                    && matches[m].match.Begin() == expected[m].match.Begin()
+                    && matches[m].match.End() == expected[m].match.End()
+                    && matches[m].captures.size() == expected[m].captures.size();
+                for (size_t c = 0; bSame && c != matches[m].captures.size(); ++c)
+                    bSame   = matches[m].captures[c].Begin() == expected[m].captures[c].Begin()
+                        && matches[m].captures[c].End() == expected[m].captures[c].End();
+            }
+            test::Check(bSame, "same matches as each pattern alone", strContext);
+        }
+    }
+}
+
+// exact literals are reported from the trie, reading no more than the longest of them
+static void
+TestLiterals() {
+    patt::PatternSet
+        set;
+    set.Add(patt::Str("abc"));
+    set.Add(patt::Str("ab"));
+    set.Add(patt::Str("b"));
+    set.Add(patt::Str("ab") >> patt::Str("c"));
+
+    test::StringStream
+        source("abcd");
+    CountingStream
+        is(source);
+    patt::SetMatchList
+        matches = set.Eval(is);
+    test::Check(matches.size() == 3
+        && matches[0].uIndex == 0 && matches[0].match.End() == 3
+        && matches[1].uIndex == 1 && matches[1].match.End() == 2
+        && matches[2].uIndex == 3 && matches[2].match.End() == 3, "literals matched");
+    test::Check(is.uReads == 3, "input read once", std::to_string(is.uReads));
+    test::Check(is.GetPosition() == 0, "position left unchanged");
+}
+
+// captures and end-of-input patterns at the end of the input
+static void
+TestAtEnd() {
+    patt::PatternSet
+        set;
+    set.Add(patt::None());
+    set.Add(patt::Capt(patt::Str("a")));
+    set.Add(patt::Capt(patt::Str("")) >> patt::None());
+    set.Add(patt::Str("a") >> patt::None());
+
+    test::StringStream
+        is("xa");
+    is.SetPosition(2);
+    patt::SetMatchList
+        matches = set.Eval(is);
+    test::Check(matches.size() == 2
+        && matches[0].uIndex == 0
+        && matches[1].uIndex == 2 && matches[1].captures.size() == 1
+        && matches[1].captures[0].Begin() == 2, "end of input");
+    test::Check(is.GetPosition() == 2, "position left unchanged at the end");
+
+    is.SetPosition(1);
+    matches = set.Eval(is);
+    test::Check(matches.size() == 2
+        && matches[0].uIndex == 1 && matches[0].captures.size() == 1 && matches[0].captures[0].End() == 2
+        && matches[1].uIndex == 3 && matches[1].match.End() == 2, "last byte");
+    test::Check(is.GetPosition() == 1, "position left unchanged before the end");
+}
+
+int main() {
+    TestRandom();
+    TestLiterals();
+    TestAtEnd();
+    return test::Result();
+}
@@ -0,0 +1,127 @@
+#include <memory>
+#include <string>
+#include <stdexcept>
+
+#include <Patterns.hpp>
+#include <WindowStream.hpp>
+
+#include "TestStreams.hpp"
+
+// a long token stream committed after every token stays within a small window
+static void
+TestBounded() {
+    std::string
+        strInput;
+    for (size_t i = 0; i != 100000; ++i)
+        strInput    += (i % 3 != 0) ? "ab;" : "abc;";
+
+    test::PipeStream
+        source(strInput);
+    patt::WindowStream
+        window(source, 4);
+    patt::Pattern
+        ptToken     = (patt::Str("abc") |= patt::Str("ab")) >> patt::Str(";") >> patt::Commit(),
+        ptAll       = ptToken % 0 >> -patt::Any();
+    patt::CaptureList
+        captures;
+    patt::OptMatch
+        optm        = patt::Eval(ptAll, window, captures);
+
+    test::Check(optm && optm->End() == (intptr_t)strInput.size(), "whole token stream matched");
+    test::Check(window.Capacity() <= 16, "window stays bounded", std::to_string(window.Capacity()));
+    // the repetition still needs the start of the token it's in
+    test::Check(window.Base() == (intptr_t)strInput.size() - 4, "committed up to the last token");
+    window.Commit();
+    test::Check(window.Base() == (intptr_t)strInput.size(), "everything committed");
+}
+
+// a commit inside a failing alternative keeps what the choice rewinds to
+static void
+TestCommitInChoice() {
+    patt::Pattern
+        pattern     = (patt::Str("a") >> patt::Commit() >> patt::Str("bc")) |= patt::Str("abx");
+    patt::CaptureList
+        captures;
+
+    test::PipeStream
+        source("abx");
+    patt::WindowStream
+        window(source, 2);
+    patt::OptMatch
+        optm        = patt::Eval(pattern, window, captures);
+    test::Check(optm && optm->End() == 3, "second alternative after a commit");
+}
+
+// backtrack points belong to the window being evaluated, not to the newest one
+static void
+TestTwoWindows() {
+    patt::Pattern
+        pattern     = (patt::Str("a") >> patt::Commit() >> patt::Str("bc")) |= patt::Str("abx");
+    patt::CaptureList
+        captures;
+
+    test::PipeStream
+        sourceOld("abx"),
+        sourceNew("zzz");
+    auto
+        lpOld       = std::make_unique<patt::WindowStream>(sourceOld, 2);
+    auto
+        lpNew       = std::make_unique<patt::WindowStream>(sourceNew, 2);
+
+    try {
+        patt::OptMatch
+            optm    = patt::Eval(pattern, *lpOld, captures);
+        test::Check(optm && optm->End() == 3, "older window matched");
+    }
+    catch (const std::exception& e) {
+        test::Check(false, "older window threw", e.what());
+    }
+
+    // destroyed out of order, the remaining window still tracks its points
+    lpOld.reset();
+    test::PipeStream
+        sourceLast("abx");
+    patt::WindowStream
+        windowLast(sourceLast, 2);
+    lpNew.reset();
+    try {
+        patt::OptMatch
+            optm    = patt::Eval(pattern, windowLast, captures);
+        test::Check(optm && optm->End() == 3, "window after out-of-order destruction matched");
+    }
+    catch (const std::exception& e) {
+        test::Check(false, "window after out-of-order destruction threw", e.what());
+    }
+}
+
+// rewinding before the committed offset is refused
+static void
+TestCommittedSeek() {
+    test::PipeStream
+        source("abcdef");
+    patt::WindowStream
+        window(source, 2);
+    patt::CaptureList
+        captures;
+    (void)patt::Eval(patt::Str("abc"), window, captures);
+    window.Commit();
+
+    bool
+        bThrown     = false;
+    try {
+        window.SetPosition(1);
+    }
+    catch (const std::out_of_range&) {
+        bThrown     = true;
+    }
+    test::Check(bThrown, "seek before the committed offset throws");
+    test::Check(window.Base() == 3, "base moved to the commit");
+}
+
+int main() {
+    TestBounded();
+    TestCommitInChoice();
+    TestTwoWindows();
+    TestCommittedSeek();
+    return test::Result();
+}